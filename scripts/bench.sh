@@ -0,0 +1,283 @@
+#!/bin/bash
+
+# Benchmark corpus generation and throughput comparison for cj
+
+set -e  # Exit on error
+set -u  # Exit on undefined variable
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+# Configuration
+BENCH_DIR="${BENCH_DIR:-bench}"
+BENCH_ROWS="${BENCH_ROWS:-200000}"
+BENCH_RUNS="${BENCH_RUNS:-5}"
+
+log_info() {
+    echo -e "${BLUE}[INFO]${NC} $1"
+}
+
+log_success() {
+    echo -e "${GREEN}[SUCCESS]${NC} $1"
+}
+
+log_warning() {
+    echo -e "${YELLOW}[WARNING]${NC} $1"
+}
+
+log_error() {
+    echo -e "${RED}[ERROR]${NC} $1" >&2
+}
+
+# Generates the corpus once; files are reused until BENCH_ROWS changes
+generate_corpus() {
+    local dir=$1
+    local stamp="$dir/.rows-$BENCH_ROWS"
+
+    if [ -f "$stamp" ]; then
+        log_info "Reusing benchmark corpus in $dir/"
+        return 0
+    fi
+
+    log_info "Generating benchmark corpus ($BENCH_ROWS rows per file) in $dir/..."
+    rm -rf "$dir"
+    mkdir -p "$dir"
+
+    # Short mixed cells: the common case for log and export feeds
+    awk -v rows="$BENCH_ROWS" 'BEGIN {
+        print "id,name,city,amount,ratio,created_at,memo";
+        for (i = 0; i < rows; i++) {
+            printf "%d,user_%d,city_%d,%d,%.4f,2025-07-%02d 10:%02d:00,\n",
+                   i, i % 9973, i % 211, (i * 7919) % 100000, (i % 1000) / 997.0,
+                   i % 28 + 1, i % 60;
+        }
+    }' > "$dir/mixed.csv"
+
+    # Quoted fields with embedded commas, doubled quotes, tabs and newlines
+    awk -v rows="$BENCH_ROWS" 'BEGIN {
+        print "id,title,body,tags";
+        for (i = 0; i < rows; i++) {
+            printf "%d,\"Title %d, part %d\",\"He said \"\"hello\"\"\tthen\nleft line %d\",'"'"'a,b,%d'"'"'\n",
+                   i, i, i % 7, i, i % 13;
+        }
+    }' > "$dir/quoted.csv"
+
+    # Wide numeric rows: stresses is_numeric() and the value writer
+    awk -v rows="$BENCH_ROWS" 'BEGIN {
+        printf "c0";
+        for (c = 1; c < 24; c++) printf ",c%d", c;
+        printf "\n";
+        for (i = 0; i < rows / 4; i++) {
+            printf "%d", i;
+            for (c = 1; c < 24; c++) printf ",%d.%d", (i * c) % 10007, c;
+            printf "\n";
+        }
+    }' > "$dir/numeric.csv"
+
+    touch "$stamp"
+    log_success "Corpus ready: $(ls "$dir"/*.csv | wc -l | tr -d ' ') files"
+}
+
+# Training-only inputs, rebuilt from the corpus on every run: the mixed file
+# (no quotes or delimiters inside fields) with each other specialized
+# delimiter, and text with multibyte and ill-formed UTF-8
+generate_training_inputs() {
+    local dir=$1
+    local train_dir="$dir/train"
+
+    rm -rf "$train_dir"
+    mkdir -p "$train_dir"
+    tr ',' '\t' < "$dir/mixed.csv" > "$train_dir/mixed.tsv"
+    tr ',' '|' < "$dir/mixed.csv" > "$train_dir/mixed.psv"
+    tr ',' ';' < "$dir/mixed.csv" > "$train_dir/mixed.ssv"
+
+    awk -v rows="$BENCH_ROWS" 'BEGIN {
+        print "id,city,note";
+        for (i = 0; i < rows / 4; i++) {
+            printf "%d,S\303\243o Paulo %d,\346\227\245\346\234\254 caf\303\251 %d\n", i, i % 97, i;
+        }
+    }' > "$train_dir/utf8.csv"
+    awk -v rows="$BENCH_ROWS" 'BEGIN {
+        print "id,raw";
+        for (i = 0; i < rows / 4; i++) {
+            printf "%d,bad \377 byte \303 cut %d\n", i, i;
+        }
+    }' > "$train_dir/invalid-utf8.csv"
+}
+
+# Runs the binary over the corpus in every output format, then over each
+# specialized kernel family and UTF-8 policy (used as the PGO training run)
+train() {
+    local binary=$1
+    local dir=$2
+    local train_dir="$dir/train"
+
+    for file in "$dir"/*.csv; do
+        "$binary" "$file" > /dev/null
+        "$binary" --styled "$file" > /dev/null
+        "$binary" --ndjson "$file" > /dev/null
+        "$binary" --format msgpack "$file" > /dev/null
+        "$binary" --format cbor "$file" > /dev/null
+    done
+
+    generate_training_inputs "$dir"
+    "$binary" --delimiter tab "$train_dir/mixed.tsv" > /dev/null
+    "$binary" --delimiter tab --quote none "$train_dir/mixed.tsv" > /dev/null
+    "$binary" --delimiter '|' "$train_dir/mixed.psv" > /dev/null
+    "$binary" --delimiter ';' --format msgpack "$train_dir/mixed.ssv" > /dev/null
+    "$binary" --quote '"' "$dir/quoted.csv" > /dev/null
+    "$binary" --no-trim "$dir/mixed.csv" > /dev/null
+
+    "$binary" "$train_dir/utf8.csv" > /dev/null
+    "$binary" --format cbor "$train_dir/utf8.csv" > /dev/null
+    "$binary" --invalid-utf8 error "$train_dir/utf8.csv" > /dev/null
+    "$binary" "$train_dir/invalid-utf8.csv" > /dev/null
+    "$binary" --invalid-utf8 pass "$train_dir/invalid-utf8.csv" > /dev/null
+    # Rejects the first data row; trains the error path only
+    "$binary" --invalid-utf8 error "$train_dir/invalid-utf8.csv" > /dev/null 2>&1 || true
+}
+
+# Prints the best wall-clock time in seconds over BENCH_RUNS runs
+best_time() {
+    local best=""
+    local elapsed
+    TIMEFORMAT=%R
+    for _ in $(seq "$BENCH_RUNS"); do
+        elapsed=$( { time "$@" > /dev/null; } 2>&1 )
+        if [ -z "$best" ] || awk -v a="$elapsed" -v b="$best" 'BEGIN { exit !(a < b) }'; then
+            best=$elapsed
+        fi
+    done
+    echo "$best"
+}
+
+compare() {
+    local baseline=$1
+    local candidate=$2
+    local dir=$3
+
+    for binary in "$baseline" "$candidate"; do
+        if [ ! -x "$binary" ]; then
+            log_error "Binary not found: $binary"
+            exit 1
+        fi
+    done
+
+    log_info "Comparing $baseline (baseline) against $candidate, best of $BENCH_RUNS runs"
+    printf "\n%-14s %12s %12s %10s\n" "file" "baseline" "candidate" "speedup"
+
+    for file in "$dir"/*.csv; do
+        local bytes
+        bytes=$(wc -c < "$file" | tr -d ' ')
+        local base_time
+        local cand_time
+        base_time=$(best_time "$baseline" "$file")
+        cand_time=$(best_time "$candidate" "$file")
+        awk -v name="$(basename "$file")" -v bytes="$bytes" -v a="$base_time" -v b="$cand_time" 'BEGIN {
+            if (a <= 0) a = 0.001;
+            if (b <= 0) b = 0.001;
+            printf "%-14s %8.1f MB/s %8.1f MB/s %9.2fx\n",
+                   name, bytes / a / 1048576, bytes / b / 1048576, a / b;
+        }'
+    done
+    echo ""
+}
+
+# Compares --io stdio and --io async for one binary, writing into a pipe and into a file
+io_compare() {
+    local binary=$1
+    local dir=$2
+    local sink="$dir/io-output.json"
+
+    if [ ! -x "$binary" ]; then
+        log_error "Binary not found: $binary"
+        exit 1
+    fi
+
+    log_info "Comparing --io stdio against --io async for $binary, best of $BENCH_RUNS runs"
+    printf "\n%-14s %-6s %12s %12s %10s\n" "file" "target" "stdio" "async" "speedup"
+
+    for file in "$dir"/*.csv; do
+        local bytes
+        bytes=$(wc -c < "$file" | tr -d ' ')
+        for target in pipe file; do
+            local stdio_time
+            local async_time
+            if [ "$target" = "pipe" ]; then
+                stdio_time=$(best_time bash -c '"$0" --io stdio "$1" | cat > /dev/null' "$binary" "$file")
+                async_time=$(best_time bash -c '"$0" --io async "$1" | cat > /dev/null' "$binary" "$file")
+            else
+                stdio_time=$(best_time bash -c '"$0" --io stdio "$1" > "$2"' "$binary" "$file" "$sink")
+                async_time=$(best_time bash -c '"$0" --io async "$1" > "$2"' "$binary" "$file" "$sink")
+            fi
+            awk -v name="$(basename "$file")" -v target="$target" -v bytes="$bytes" \
+                -v a="$stdio_time" -v b="$async_time" 'BEGIN {
+                if (a <= 0) a = 0.001;
+                if (b <= 0) b = 0.001;
+                printf "%-14s %-6s %8.1f MB/s %8.1f MB/s %9.2fx\n",
+                       name, target, bytes / a / 1048576, bytes / b / 1048576, a / b;
+            }'
+        done
+    done
+    rm -f "$sink"
+    echo ""
+}
+
+print_usage() {
+    echo "Usage: $0 COMMAND [ARGS]"
+    echo ""
+    echo "Commands:"
+    echo "  corpus [DIR]                       Generate the benchmark corpus (default: $BENCH_DIR)"
+    echo "  train BINARY [DIR]                 Run BINARY over the corpus (PGO training run)"
+    echo "  compare BASELINE CANDIDATE [DIR]   Compare throughput of two binaries"
+    echo "  io BINARY [DIR]                    Compare --io stdio and --io async output"
+    echo ""
+    echo "Environment:"
+    echo "  BENCH_ROWS   Rows per corpus file (default: 200000)"
+    echo "  BENCH_RUNS   Timed runs per file, best is reported (default: 5)"
+}
+
+main() {
+    if [ $# -lt 1 ]; then
+        print_usage
+        exit 1
+    fi
+
+    local command=$1
+    shift
+
+    case "$command" in
+        corpus)
+            generate_corpus "${1:-$BENCH_DIR}"
+            ;;
+        train)
+            [ $# -ge 1 ] || { print_usage; exit 1; }
+            generate_corpus "${2:-$BENCH_DIR}"
+            train "$1" "${2:-$BENCH_DIR}"
+            ;;
+        compare)
+            [ $# -ge 2 ] || { print_usage; exit 1; }
+            generate_corpus "${3:-$BENCH_DIR}"
+            compare "$1" "$2" "${3:-$BENCH_DIR}"
+            ;;
+        io)
+            [ $# -ge 1 ] || { print_usage; exit 1; }
+            generate_corpus "${2:-$BENCH_DIR}"
+            io_compare "$1" "${2:-$BENCH_DIR}"
+            ;;
+        -h|--help)
+            print_usage
+            ;;
+        *)
+            log_error "Unknown command: $command"
+            print_usage
+            exit 1
+            ;;
+    esac
+}
+
+main "$@"
@@ -0,0 +1,424 @@
+#include "cj.h"
+
+// Output that hands full 1 MiB blocks to the kernel without a copy into
+// stdio. OutputBuffer writes into the current block; async_output_submit()
+// passes it on.
+//
+// Pipes use vmsplice() with SPLICE_F_GIFT: the pipe takes references to our
+// pages instead of copying them. Nothing tells us when the last reader is done
+// with them (a reader may splice() them into another pipe and read them much
+// later), so every submit maps a fresh block and unmaps the spliced one, which
+// is never written again. Partial blocks (explicit flushes) go through
+// write(), which copies, so their buffer is reused.
+//
+// Regular files use io_uring with two halves and at most one write in flight:
+// the kernel writes one half while the next is formatted, and writes stay
+// ordered even for O_APPEND files. io_uring needs <linux/io_uring.h>; without
+// it files fall back to stdio while pipes still splice. Anything else falls
+// back to stdio buffering.
+
+#ifdef PLATFORM_LINUX
+#define CJ_ASYNC_OUTPUT 1
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define CJ_HAVE_IO_URING_H 1
+#endif
+#endif
+#endif
+
+#ifdef CJ_ASYNC_OUTPUT
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#ifdef CJ_HAVE_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+
+#if !defined(CJ_HAVE_IO_URING_H) || !defined(__NR_io_uring_setup) || !defined(__NR_io_uring_enter)
+#define CJ_NO_IO_URING 1
+#endif
+
+typedef enum {
+    ASYNC_SPLICE,
+    ASYNC_URING
+} AsyncMode;
+
+struct AsyncOutput {
+    AsyncMode mode;
+    int fd;
+    char* blocks[2];
+    int current;
+    size_t block_size;
+    int splice_disabled;        // vmsplice unsupported: write() only
+
+    // io_uring state
+    int ring_fd;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    struct iovec iov;           // the write in flight, if any
+    long long iov_offset;
+    int in_flight;
+    long long offset;           // file offset of the next write
+    int append;
+};
+
+static int wait_writable(int fd) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    return poll(&pfd, 1, -1) < 0 && errno != EINTR ? -1 : 0;
+}
+
+static int write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN && wait_writable(fd) == 0) continue;
+            return -1;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+// Splice backend
+
+static int splice_block(AsyncOutput* async, const char* data, size_t length) {
+    size_t done = 0;
+    while (done < length) {
+        struct iovec iov;
+        iov.iov_base = (void*)(data + done);
+        iov.iov_len = length - done;
+        ssize_t n = vmsplice(async->fd, &iov, 1, SPLICE_F_GIFT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN && wait_writable(async->fd) == 0) continue;
+            if (done == 0 && (errno == EINVAL || errno == ENOSYS)) {
+                async->splice_disabled = 1;
+                return write_all(async->fd, data, length);
+            }
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+static int splice_submit(OutputBuffer* out) {
+    AsyncOutput* async = out->async;
+    if (async->splice_disabled || out->length < async->block_size) {
+        return write_all(async->fd, out->data, out->length);
+    }
+
+    // Map the next block first so a failure leaves out->data usable
+    char* next = mmap(NULL, async->block_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (next == MAP_FAILED) return write_all(async->fd, out->data, out->length);
+
+    if (splice_block(async, out->data, out->length) != 0) {
+        munmap(next, async->block_size);
+        return -1;
+    }
+    if (async->splice_disabled) {
+        // Fell back to write(): the block was copied and can be kept
+        munmap(next, async->block_size);
+        return 0;
+    }
+    // The pipe holds its own references to the spliced pages
+    munmap(out->data, async->block_size);
+    out->data = next;
+    async->blocks[async->current] = next;
+    return 0;
+}
+
+static int splice_open(AsyncOutput* async) {
+    // Best effort: a pipe holding a whole block lets one vmsplice() take it
+    fcntl(async->fd, F_SETPIPE_SZ, ASYNC_OUTPUT_BLOCK_SIZE);
+    async->block_size = ASYNC_OUTPUT_BLOCK_SIZE;
+    return 0;
+}
+
+// io_uring backend
+
+#ifndef CJ_NO_IO_URING
+
+static int uring_enter(AsyncOutput* async, unsigned to_submit, unsigned min_complete) {
+    for (;;) {
+        long result = syscall(__NR_io_uring_enter, async->ring_fd, to_submit, min_complete,
+                              min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (result >= 0) return 0;
+        if (errno != EINTR) return -1;
+    }
+}
+
+// Reaps the write in flight; short writes are finished synchronously
+static int uring_wait(AsyncOutput* async) {
+    if (!async->in_flight) return 0;
+
+    int result;
+    for (;;) {
+        unsigned head = *async->cq_head;
+        if (head != __atomic_load_n(async->cq_tail, __ATOMIC_ACQUIRE)) {
+            result = async->cqes[head & *async->cq_mask].res;
+            __atomic_store_n(async->cq_head, head + 1, __ATOMIC_RELEASE);
+            break;
+        }
+        if (uring_enter(async, 0, 1) != 0) return -1;
+    }
+    async->in_flight = 0;
+    if (result < 0) return -1;
+
+    size_t written = (size_t)result;
+    const char* rest = (const char*)async->iov.iov_base + written;
+    size_t remaining = async->iov.iov_len - written;
+    long long offset = async->iov_offset + (long long)written;
+    while (remaining > 0) {
+        ssize_t n = async->append ? write(async->fd, rest, remaining)
+                                  : pwrite(async->fd, rest, remaining, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) return -1;
+        rest += n;
+        remaining -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int uring_submit(OutputBuffer* out, int wait) {
+    AsyncOutput* async = out->async;
+
+    // The other half is about to become current; its write must be complete
+    if (uring_wait(async) != 0) return -1;
+
+    if (out->length > 0) {
+        async->iov.iov_base = out->data;
+        async->iov.iov_len = out->length;
+        async->iov_offset = async->offset;
+
+        unsigned tail = *async->sq_tail;
+        unsigned index = tail & *async->sq_mask;
+        struct io_uring_sqe* sqe = &async->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = async->fd;
+        sqe->addr = (unsigned long long)(uintptr_t)&async->iov;
+        sqe->len = 1;
+        sqe->off = (unsigned long long)async->offset;
+        async->sq_array[index] = index;
+        __atomic_store_n(async->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        if (uring_enter(async, 1, 0) != 0) return -1;
+        async->in_flight = 1;
+        async->offset += (long long)out->length;
+
+        async->current ^= 1;
+        out->data = async->blocks[async->current];
+    }
+
+    if (wait) {
+        if (uring_wait(async) != 0) return -1;
+        // Leave the descriptor where a synchronous writer would have left it
+        if (!async->append) lseek(async->fd, (off_t)async->offset, SEEK_SET);
+    }
+    return 0;
+}
+
+static void uring_close(AsyncOutput* async) {
+    if (async->sqes) munmap(async->sqes, async->sqes_size);
+    if (async->cq_ring && async->cq_ring != async->sq_ring) munmap(async->cq_ring, async->cq_ring_size);
+    if (async->sq_ring) munmap(async->sq_ring, async->sq_ring_size);
+    if (async->ring_fd >= 0) close(async->ring_fd);
+}
+
+static int uring_open(AsyncOutput* async) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    async->ring_fd = (int)syscall(__NR_io_uring_setup, 2, &params);
+    if (async->ring_fd < 0) return -1;   // e.g. disabled by sysctl or seccomp
+
+    async->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    async->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (async->cq_ring_size > async->sq_ring_size) async->sq_ring_size = async->cq_ring_size;
+        async->cq_ring_size = async->sq_ring_size;
+    }
+
+    async->sq_ring = mmap(NULL, async->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          async->ring_fd, IORING_OFF_SQ_RING);
+    if (async->sq_ring == MAP_FAILED) {
+        async->sq_ring = NULL;
+        uring_close(async);
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        async->cq_ring = async->sq_ring;
+    } else {
+        async->cq_ring = mmap(NULL, async->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              async->ring_fd, IORING_OFF_CQ_RING);
+        if (async->cq_ring == MAP_FAILED) {
+            async->cq_ring = NULL;
+            uring_close(async);
+            return -1;
+        }
+    }
+    async->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    async->sqes = mmap(NULL, async->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       async->ring_fd, IORING_OFF_SQES);
+    if (async->sqes == MAP_FAILED) {
+        async->sqes = NULL;
+        uring_close(async);
+        return -1;
+    }
+
+    char* sq = async->sq_ring;
+    char* cq = async->cq_ring;
+    async->sq_head = (unsigned*)(sq + params.sq_off.head);
+    async->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    async->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    async->sq_array = (unsigned*)(sq + params.sq_off.array);
+    async->cq_head = (unsigned*)(cq + params.cq_off.head);
+    async->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    async->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    async->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    off_t offset = lseek(async->fd, 0, SEEK_CUR);
+    if (offset < 0) {
+        uring_close(async);
+        return -1;
+    }
+    async->offset = (long long)offset;
+    async->append = (fcntl(async->fd, F_GETFL) & O_APPEND) != 0;
+    async->block_size = ASYNC_OUTPUT_BLOCK_SIZE;
+    return 0;
+}
+
+#else
+
+static int uring_submit(OutputBuffer* out, int wait) {
+    (void)out;
+    (void)wait;
+    return -1;
+}
+
+static void uring_close(AsyncOutput* async) {
+    (void)async;
+}
+
+static int uring_open(AsyncOutput* async) {
+    (void)async;
+    return -1;
+}
+
+#endif
+
+int output_init_async(OutputBuffer* out, FILE* file) {
+    struct stat st;
+    if (fflush(file) != 0 || fstat(fileno(file), &st) != 0) return output_init(out, file);
+    if (!S_ISFIFO(st.st_mode) && !S_ISREG(st.st_mode)) return output_init(out, file);
+
+    AsyncOutput* async = calloc(1, sizeof(AsyncOutput));
+    if (!async) return output_init(out, file);
+    async->fd = fileno(file);
+    async->ring_fd = -1;
+
+    int opened;
+    if (S_ISFIFO(st.st_mode)) {
+        async->mode = ASYNC_SPLICE;
+        opened = splice_open(async);
+    } else {
+        async->mode = ASYNC_URING;
+        opened = uring_open(async);
+    }
+    if (opened != 0) {
+        free(async);
+        return output_init(out, file);
+    }
+
+    // mmap rather than malloc: page-aligned for vmsplice(), and pages still
+    // referenced by the pipe after munmap() are never handed out again.
+    // The splice backend replaces its single block after every splice.
+    int blocks = async->mode == ASYNC_SPLICE ? 1 : 2;
+    char* memory = mmap(NULL, async->block_size * blocks, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        uring_close(async);
+        free(async);
+        return output_init(out, file);
+    }
+    async->blocks[0] = memory;
+    async->blocks[1] = blocks == 2 ? memory + async->block_size : NULL;
+
+    out->data = async->blocks[0];
+    out->length = 0;
+    out->capacity = async->block_size;
+    out->file = file;
+    out->error = 0;
+    out->async = async;
+    return 0;
+}
+
+int async_output_submit(OutputBuffer* out, int wait) {
+    if (out->error) return -1;
+
+    int result = out->async->mode == ASYNC_SPLICE ? splice_submit(out) : uring_submit(out, wait);
+    if (result != 0) {
+        out->error = 1;
+        return -1;
+    }
+    out->length = 0;
+    return 0;
+}
+
+void async_output_close(OutputBuffer* out) {
+    AsyncOutput* async = out->async;
+#ifndef CJ_NO_IO_URING
+    if (async->mode == ASYNC_URING && uring_wait(async) != 0) out->error = 1;
+#endif
+    uring_close(async);
+    munmap(async->blocks[0], async->block_size * (async->blocks[1] ? 2 : 1));
+    free(async);
+    out->async = NULL;
+    out->data = NULL;
+}
+
+#else
+
+int output_init_async(OutputBuffer* out, FILE* file) {
+    return output_init(out, file);
+}
+
+int async_output_submit(OutputBuffer* out, int wait) {
+    (void)wait;
+    out->error = 1;
+    return -1;
+}
+
+void async_output_close(OutputBuffer* out) {
+    out->async = NULL;
+}
+
+#endif
@@ -0,0 +1,213 @@
+#include "cj.h"
+
+// Rows become maps keyed by header, wrapped in one array per document.
+// Numbers use native integer/float encodings (see parse_number()); all other
+// values are written as raw strings, so no escaping is needed. Strings follow
+// the invalid UTF-8 policy like JSON does, so CBOR text stays well-formed.
+
+static void write_be(OutputBuffer* out, unsigned long long value, int bytes) {
+    char buffer[8];
+    for (int i = bytes - 1; i >= 0; i--) {
+        buffer[i] = (char)(value & 0xff);
+        value >>= 8;
+    }
+    output_write(out, buffer, bytes);
+}
+
+static unsigned long long double_bits(double value) {
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Encoded length of the length bytes at str; sets *replace when ill-formed
+// UTF-8 must be substituted
+static size_t text_length(const char* str, size_t length, int* replace) {
+    *replace = utf8_get_policy() == INVALID_UTF8_REPLACE &&
+               utf8_valid_prefix(str, length) != length;
+    return *replace ? utf8_sanitize(NULL, str, length) : length;
+}
+
+static void text_bytes(OutputBuffer* out, const char* str, size_t length, int replace) {
+    if (replace) {
+        utf8_sanitize(out, str, length);
+    } else {
+        output_write(out, str, length);
+    }
+}
+
+// Header name lengths, measured once per call instead of once per row
+static size_t* header_lengths(OutputBuffer* out, const CSVData* csv) {
+    size_t* lengths = malloc((csv->num_headers > 0 ? csv->num_headers : 1) * sizeof(size_t));
+    if (!lengths) {
+        out->error = 1;
+        return NULL;
+    }
+    for (int j = 0; j < csv->num_headers; j++) {
+        lengths[j] = strlen(csv->headers[j]);
+    }
+    return lengths;
+}
+
+// MessagePack
+
+static void msgpack_head(OutputBuffer* out, unsigned long long length,
+                         int fix_tag, unsigned long long fix_limit, int tag16) {
+    if (length < fix_limit) {
+        output_putc(out, (char)(fix_tag | (int)length));
+    } else if (length <= 0xffff) {
+        output_putc(out, (char)tag16);
+        write_be(out, length, 2);
+    } else {
+        output_putc(out, (char)(tag16 + 1));
+        write_be(out, length, 4);
+    }
+}
+
+static void msgpack_string(OutputBuffer* out, const char* str, size_t str_length) {
+    int replace;
+    size_t length = text_length(str, str_length, &replace);
+    if (length >= 32 && length <= 0xff) {
+        output_putc(out, (char)0xd9);
+        output_putc(out, (char)length);
+    } else {
+        msgpack_head(out, length, 0xa0, 32, 0xda);
+    }
+    text_bytes(out, str, str_length, replace);
+}
+
+static void msgpack_integer(OutputBuffer* out, long long value) {
+    if (value >= 0) {
+        unsigned long long u = (unsigned long long)value;
+        if (u <= 0x7f) {
+            output_putc(out, (char)u);
+        } else if (u <= 0xff) {
+            output_putc(out, (char)0xcc);
+            write_be(out, u, 1);
+        } else if (u <= 0xffff) {
+            output_putc(out, (char)0xcd);
+            write_be(out, u, 2);
+        } else if (u <= 0xffffffffULL) {
+            output_putc(out, (char)0xce);
+            write_be(out, u, 4);
+        } else {
+            output_putc(out, (char)0xcf);
+            write_be(out, u, 8);
+        }
+    } else if (value >= -32) {
+        output_putc(out, (char)(0xe0 | (int)(value + 32)));
+    } else if (value >= -128) {
+        output_putc(out, (char)0xd0);
+        write_be(out, (unsigned long long)value, 1);
+    } else if (value >= -32768) {
+        output_putc(out, (char)0xd1);
+        write_be(out, (unsigned long long)value, 2);
+    } else if (value >= -2147483647LL - 1) {
+        output_putc(out, (char)0xd2);
+        write_be(out, (unsigned long long)value, 4);
+    } else {
+        output_putc(out, (char)0xd3);
+        write_be(out, (unsigned long long)value, 8);
+    }
+}
+
+static void msgpack_value(OutputBuffer* out, const char* value, size_t length) {
+    long long int_value;
+    double float_value;
+    switch (parse_number(value, &int_value, &float_value)) {
+        case NUMBER_INTEGER:
+            msgpack_integer(out, int_value);
+            break;
+        case NUMBER_FLOAT:
+            output_putc(out, (char)0xcb);
+            write_be(out, double_bits(float_value), 8);
+            break;
+        default:
+            msgpack_string(out, value, length);
+            break;
+    }
+}
+
+void write_msgpack_rows(OutputBuffer* out, CSVData* csv, int start, int end) {
+    size_t* key_lengths = header_lengths(out, csv);
+    if (!key_lengths) return;
+    msgpack_head(out, (unsigned long long)(end - start), 0x90, 16, 0xdc);
+    for (int i = start; i < end; i++) {
+        msgpack_head(out, (unsigned long long)csv->num_headers, 0x80, 16, 0xde);
+        for (int j = 0; j < csv->num_headers; j++) {
+            msgpack_string(out, csv->headers[j], key_lengths[j]);
+            msgpack_value(out, csv_cell(csv, i, j), csv_cell_length(csv, i, j));
+        }
+    }
+    free(key_lengths);
+}
+
+// CBOR (RFC 8949)
+
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+
+static void cbor_head(OutputBuffer* out, int major, unsigned long long value) {
+    int tag = major << 5;
+    if (value < 24) {
+        output_putc(out, (char)(tag | (int)value));
+    } else if (value <= 0xff) {
+        output_putc(out, (char)(tag | 24));
+        write_be(out, value, 1);
+    } else if (value <= 0xffff) {
+        output_putc(out, (char)(tag | 25));
+        write_be(out, value, 2);
+    } else if (value <= 0xffffffffULL) {
+        output_putc(out, (char)(tag | 26));
+        write_be(out, value, 4);
+    } else {
+        output_putc(out, (char)(tag | 27));
+        write_be(out, value, 8);
+    }
+}
+
+static void cbor_string(OutputBuffer* out, const char* str, size_t str_length) {
+    int replace;
+    size_t length = text_length(str, str_length, &replace);
+    cbor_head(out, CBOR_TEXT, length);
+    text_bytes(out, str, str_length, replace);
+}
+
+static void cbor_value(OutputBuffer* out, const char* value, size_t length) {
+    long long int_value;
+    double float_value;
+    switch (parse_number(value, &int_value, &float_value)) {
+        case NUMBER_INTEGER:
+            if (int_value >= 0) {
+                cbor_head(out, CBOR_UNSIGNED, (unsigned long long)int_value);
+            } else {
+                // -1 - n without overflowing on LLONG_MIN
+                cbor_head(out, CBOR_NEGATIVE, (unsigned long long)(-(int_value + 1)));
+            }
+            break;
+        case NUMBER_FLOAT:
+            output_putc(out, (char)0xfb);
+            write_be(out, double_bits(float_value), 8);
+            break;
+        default:
+            cbor_string(out, value, length);
+            break;
+    }
+}
+
+void write_cbor_rows(OutputBuffer* out, CSVData* csv, int start, int end) {
+    size_t* key_lengths = header_lengths(out, csv);
+    if (!key_lengths) return;
+    cbor_head(out, CBOR_ARRAY, (unsigned long long)(end - start));
+    for (int i = start; i < end; i++) {
+        cbor_head(out, CBOR_MAP, (unsigned long long)csv->num_headers);
+        for (int j = 0; j < csv->num_headers; j++) {
+            cbor_string(out, csv->headers[j], key_lengths[j]);
+            cbor_value(out, csv_cell(csv, i, j), csv_cell_length(csv, i, j));
+        }
+    }
+    free(key_lengths);
+}
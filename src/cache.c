@@ -0,0 +1,515 @@
+#include "cj.h"
+
+// Incremental conversion (--cache DIR). The input is cut into content-defined
+// chunks that always end on a record boundary: a gear hash over the bytes
+// proposes cut points, and the chunk ends at the first record end after one.
+// Each chunk's rendered rows are stored in DIR as a fragment named by a hash
+// of the chunk and of everything else the output depends on (headers,
+// dialect, format), so a chunk seen before is copied from its fragment
+// without being parsed. An edit changes only the chunks around it; the cut
+// points resynchronize within a chunk or two.
+//
+// DIR/index lists the fragments with their size, row count and last use. It
+// is rewritten after every run, evicting the least recently used fragments
+// beyond the size limit. One cj process should use a cache directory at a time.
+
+#define CACHE_INDEX_MAGIC "cj-cache"
+
+typedef struct {
+    uint64_t key[2];
+    long long size;             // fragment bytes
+    long long rows;
+    long long last_used;        // cache clock at the last hit or store
+} CacheEntry;
+
+typedef struct {
+    const char* dir;
+    CacheEntry* entries;
+    int num_entries;
+    int capacity;
+    int* slots;                 // open addressing into entries, -1 = free
+    int num_slots;
+    long long clock;
+    int store_failed;           // new fragments are no longer stored
+} ChunkCache;
+
+// min_size, max_size and cut_bits are CACHE_CHUNK_MIN, CACHE_CHUNK_MAX and
+// CACHE_CHUNK_BITS for the cache; tests pass tiny sizes to cut small inputs
+void cache_chunker_init(CacheChunker* chunker, size_t min_size, size_t max_size, int cut_bits) {
+    memset(chunker, 0, sizeof(*chunker));
+    chunker->min_size = min_size;
+    chunker->max_size = max_size;
+    chunker->cut_bits = cut_bits;
+    // splitmix64, so the table (and with it every chunk boundary) is fixed
+    uint64_t state = 0;
+    for (int i = 0; i < 256; i++) {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        chunker->gear[i] = z ^ (z >> 31);
+    }
+    for (const char* q = csv_get_dialect()->quotes; *q; q++) {
+        chunker->is_quote[(unsigned char)*q] = 1;
+    }
+}
+
+// Length of the next chunk of data[0..length), or 0 if more input is needed.
+// Quote tracking mirrors the record reader, so chunks hold whole records.
+size_t cache_chunker_next(CacheChunker* chunker, const char* data, size_t length, int at_eof) {
+    size_t i = chunker->pos;
+    while (i < length) {
+        unsigned char c = (unsigned char)data[i];
+        // A '\n' after this '\r' would belong to the same record
+        if (c == '\r' && !chunker->quote_char && i + 1 == length && !at_eof) break;
+
+        // The top bits of a gear hash depend on the last 64 bytes only
+        chunker->hash = (chunker->hash << 1) + chunker->gear[c];
+        if (i >= chunker->min_size && (chunker->hash >> (64 - chunker->cut_bits)) == 0) {
+            chunker->pending = 1;
+        }
+        i++;
+
+        if (chunker->quote_char) {
+            // A doubled quote closes and reopens, which leaves the state unchanged
+            if (c == chunker->quote_char) chunker->quote_char = 0;
+        } else if (chunker->is_quote[c]) {
+            chunker->quote_char = c;
+        } else if (c == '\n' || (c == '\r' && (i == length || data[i] != '\n'))) {
+            if (chunker->pending || i >= chunker->max_size) {
+                chunker->pending = 0;
+                chunker->pos = 0;
+                return i;
+            }
+        }
+    }
+
+    chunker->pos = i;
+    if (at_eof && length > 0) {
+        chunker->pending = 0;
+        chunker->pos = 0;
+        return length;
+    }
+    return 0;
+}
+
+static void cache_path(const ChunkCache* cache, const uint64_t key[2], const char* suffix,
+                       char* path, size_t size) {
+    snprintf(path, size, "%s" PATH_SEPARATOR "%016llx%016llx.%s", cache->dir,
+             (unsigned long long)key[0], (unsigned long long)key[1], suffix);
+}
+
+static CacheEntry* cache_find(const ChunkCache* cache, const uint64_t key[2]) {
+    int mask = cache->num_slots - 1;
+    for (int slot = (int)(key[0] & (uint64_t)mask); cache->slots[slot] >= 0; slot = (slot + 1) & mask) {
+        CacheEntry* entry = &cache->entries[cache->slots[slot]];
+        if (entry->key[0] == key[0] && entry->key[1] == key[1]) return entry;
+    }
+    return NULL;
+}
+
+static int cache_rehash(ChunkCache* cache, int num_slots) {
+    int* slots = malloc(num_slots * sizeof(int));
+    if (!slots) return -1;
+    for (int i = 0; i < num_slots; i++) slots[i] = -1;
+    for (int i = 0; i < cache->num_entries; i++) {
+        int slot = (int)(cache->entries[i].key[0] & (uint64_t)(num_slots - 1));
+        while (slots[slot] >= 0) slot = (slot + 1) & (num_slots - 1);
+        slots[slot] = i;
+    }
+    free(cache->slots);
+    cache->slots = slots;
+    cache->num_slots = num_slots;
+    return 0;
+}
+
+static CacheEntry* cache_insert(ChunkCache* cache, const uint64_t key[2]) {
+    CacheEntry* entry = cache_find(cache, key);
+    if (entry) return entry;
+
+    if (cache->num_entries >= cache->capacity) {
+        int new_capacity = cache->capacity * 2;
+        CacheEntry* new_entries = realloc(cache->entries, new_capacity * sizeof(CacheEntry));
+        if (!new_entries) return NULL;
+        cache->entries = new_entries;
+        cache->capacity = new_capacity;
+    }
+    // Keep the table at most half full
+    if ((cache->num_entries + 1) * 2 > cache->num_slots && cache_rehash(cache, cache->num_slots * 2) != 0) {
+        return NULL;
+    }
+
+    entry = &cache->entries[cache->num_entries];
+    memset(entry, 0, sizeof(*entry));
+    entry->key[0] = key[0];
+    entry->key[1] = key[1];
+
+    int mask = cache->num_slots - 1;
+    int slot = (int)(key[0] & (uint64_t)mask);
+    while (cache->slots[slot] >= 0) slot = (slot + 1) & mask;
+    cache->slots[slot] = cache->num_entries++;
+    return entry;
+}
+
+static int parse_key(const char* hex, uint64_t key[2]) {
+    if (strlen(hex) != 32) return -1;
+    for (int half = 0; half < 2; half++) {
+        char digits[17];
+        char* end;
+        memcpy(digits, hex + half * 16, 16);
+        digits[16] = '\0';
+        key[half] = (uint64_t)strtoull(digits, &end, 16);
+        if (*end != '\0') return -1;
+    }
+    return 0;
+}
+
+static int cache_open(ChunkCache* cache, const char* dir) {
+    memset(cache, 0, sizeof(*cache));
+    if (cj_mkdir(dir) != 0) {
+        fprintf(stderr, "Error: Cannot create cache directory '%s'\n", dir);
+        return -1;
+    }
+    cache->dir = dir;
+    cache->capacity = 1024;
+    cache->entries = malloc(cache->capacity * sizeof(CacheEntry));
+    if (!cache->entries || cache_rehash(cache, 2048) != 0) {
+        free(cache->entries);
+        return -1;
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s" PATH_SEPARATOR "index", dir);
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+
+    // An index from another cache version is dropped along with its fragments
+    char line[256];
+    int version = 0;
+    int current = fgets(line, sizeof(line), file) &&
+                  sscanf(line, CACHE_INDEX_MAGIC " %d %lld", &version, &cache->clock) == 2 &&
+                  version == CACHE_FORMAT_VERSION;
+    if (!current) cache->clock = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        char hex[64];
+        CacheEntry loaded;
+        if (sscanf(line, "%63s %lld %lld %lld", hex, &loaded.size, &loaded.rows, &loaded.last_used) != 4 ||
+            parse_key(hex, loaded.key) != 0) {
+            continue;
+        }
+        if (!current) {
+            cache_path(cache, loaded.key, "frag", path, sizeof(path));
+            remove(path);
+            continue;
+        }
+        CacheEntry* entry = cache_insert(cache, loaded.key);
+        if (!entry) break;
+        *entry = loaded;
+    }
+    fclose(file);
+    return 0;
+}
+
+static int compare_recent_first(const void* a, const void* b) {
+    long long x = ((const CacheEntry*)a)->last_used;
+    long long y = ((const CacheEntry*)b)->last_used;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// Evicts least recently used fragments beyond max_bytes and rewrites the index
+static void cache_close(ChunkCache* cache, long long max_bytes) {
+    char path[4096];
+    char tmp_path[4096];
+
+    qsort(cache->entries, cache->num_entries, sizeof(CacheEntry), compare_recent_first);
+    long long total = 0;
+    int kept = 0;
+    for (int i = 0; i < cache->num_entries; i++) {
+        total += cache->entries[i].size;
+        if (total <= max_bytes && kept == i) {
+            kept++;
+        } else {
+            cache_path(cache, cache->entries[i].key, "frag", path, sizeof(path));
+            remove(path);
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s" PATH_SEPARATOR "index", cache->dir);
+    snprintf(tmp_path, sizeof(tmp_path), "%s" PATH_SEPARATOR "index.tmp", cache->dir);
+    FILE* file = fopen(tmp_path, "w");
+    if (file) {
+        fprintf(file, CACHE_INDEX_MAGIC " %d %lld\n", CACHE_FORMAT_VERSION, cache->clock);
+        for (int i = 0; i < kept; i++) {
+            const CacheEntry* entry = &cache->entries[i];
+            fprintf(file, "%016llx%016llx %lld %lld %lld\n",
+                    (unsigned long long)entry->key[0], (unsigned long long)entry->key[1],
+                    entry->size, entry->rows, entry->last_used);
+        }
+        int written = fclose(file) == 0;
+#ifdef PLATFORM_WINDOWS
+        if (written) remove(path);
+#endif
+        if (!written || rename(tmp_path, path) != 0) {
+            fprintf(stderr, "Warning: Cannot write cache index '%s'\n", path);
+            remove(tmp_path);
+        }
+    } else {
+        fprintf(stderr, "Warning: Cannot write cache index '%s'\n", path);
+    }
+
+    free(cache->entries);
+    free(cache->slots);
+}
+
+static void cache_store(ChunkCache* cache, const uint64_t key[2], const OutputBuffer* fragment, long long rows) {
+    if (cache->store_failed || fragment->length == 0) return;
+
+    char path[4096];
+    char tmp_path[4096];
+    cache_path(cache, key, "frag", path, sizeof(path));
+    cache_path(cache, key, "tmp", tmp_path, sizeof(tmp_path));
+
+    // Write-then-rename, so a fragment file is always complete
+    FILE* file = fopen(tmp_path, "wb");
+    int stored = file && fwrite(fragment->data, 1, fragment->length, file) == fragment->length;
+    if (file && fclose(file) != 0) stored = 0;
+#ifdef PLATFORM_WINDOWS
+    if (stored) remove(path);
+#endif
+    if (stored && rename(tmp_path, path) != 0) stored = 0;
+
+    CacheEntry* entry = stored ? cache_insert(cache, key) : NULL;
+    if (!entry) {
+        if (file) remove(tmp_path);
+        fprintf(stderr, "Warning: Cannot store in cache directory '%s'; continuing without it\n", cache->dir);
+        cache->store_failed = 1;
+        return;
+    }
+    entry->size = (long long)fragment->length;
+    entry->rows = rows;
+    entry->last_used = ++cache->clock;
+}
+
+// Hash seeds covering everything besides the chunk bytes that shapes a fragment
+static int cache_context(const CSVData* csv, const CacheOptions* options, uint64_t context[2]) {
+    const CSVDialect* dialect = csv_get_dialect();
+    char settings[128];
+    snprintf(settings, sizeof(settings), "%d %s %d %d %d %d %d [%s]", CACHE_FORMAT_VERSION, VERSION,
+             (int)options->format, options->styled, (int)utf8_get_policy(),
+             (unsigned char)dialect->delimiter, dialect->trim, dialect->quotes);
+
+    OutputBuffer text;
+    if (output_init(&text, NULL) != 0) return -1;
+    output_write(&text, settings, strlen(settings) + 1);
+    for (int j = 0; j < csv->num_headers; j++) {
+        output_write(&text, csv->headers[j], strlen(csv->headers[j]) + 1);
+    }
+    context[0] = hash_bytes(text.data, text.length, 1);
+    context[1] = hash_bytes(text.data, text.length, 2);
+    int result = text.error ? -1 : 0;
+    output_free(&text);
+    return result;
+}
+
+typedef struct {
+    ChunkCache cache;
+    CSVData* csv;
+    OutputBuffer* out;
+    OutputBuffer fragment;
+    char* copy_buffer;
+    uint64_t context[2];
+    int styled;
+    int ndjson;
+    int emitted;                // a non-empty fragment has been written
+} CacheRun;
+
+static void emit_separator(CacheRun* run) {
+    if (run->emitted) output_puts(run->out, json_fragment_separator(run->styled, run->ndjson));
+    run->emitted = 1;
+}
+
+// Copies a stored fragment to the output. Returns 1 if it was missing or
+// damaged (nothing written), 0 on success and -1 on a read error midway.
+static int copy_fragment(CacheRun* run, const CacheEntry* entry) {
+    char path[4096];
+    cache_path(&run->cache, entry->key, "frag", path, sizeof(path));
+    FILE* file = fopen(path, "rb");
+    if (!file) return 1;
+    if (cj_fseek(file, 0, SEEK_END) != 0 || cj_ftell(file) != entry->size || entry->size == 0) {
+        fclose(file);
+        return 1;
+    }
+    cj_fseek(file, 0, SEEK_SET);
+
+    emit_separator(run);
+    long long remaining = entry->size;
+    while (remaining > 0) {
+        size_t want = remaining < OUTPUT_BUFFER_SIZE ? (size_t)remaining : OUTPUT_BUFFER_SIZE;
+        size_t got = fread(run->copy_buffer, 1, want, file);
+        if (got == 0) break;
+        output_write(run->out, run->copy_buffer, got);
+        remaining -= (long long)got;
+    }
+    fclose(file);
+    if (remaining > 0) {
+        fprintf(stderr, "Error: Cannot read cache file '%s'\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static int convert_chunk(CacheRun* run, const CacheOptions* options, const char* data, size_t length) {
+    CSVData* csv = run->csv;
+    if (!csv->headers) {
+        long long start = csv_read_headers(csv, data, length);
+        if (start < 0) return -1;
+        if (!csv->headers) return 0;        // only empty records so far
+        if (cache_context(csv, options, run->context) != 0) return -1;
+        data += start;
+        length -= (size_t)start;
+    }
+
+    uint64_t key[2];
+    key[0] = hash_bytes(data, length, run->context[0]);
+    key[1] = hash_bytes(data, length, run->context[1]);
+
+    CacheEntry* entry = cache_find(&run->cache, key);
+    if (entry) {
+        int copied = copy_fragment(run, entry);
+        if (copied < 0) return -1;
+        if (copied == 0) {
+            entry->last_used = ++run->cache.clock;
+            csv->row_base += entry->rows;
+            return 0;
+        }
+    }
+
+    CSVReader reader;
+    csv_reader_init_buffer(&reader, data, length);
+    csv_clear_rows(csv);
+    if (csv_read_all(csv, &reader) != 0) return -1;
+
+    run->fragment.length = 0;
+    write_json_fragment(&run->fragment, csv, 0, csv->num_rows, run->styled, run->ndjson);
+    if (run->fragment.error) return -1;
+    if (run->fragment.length > 0) {
+        emit_separator(run);
+        output_write(run->out, run->fragment.data, run->fragment.length);
+    }
+    cache_store(&run->cache, key, &run->fragment, csv->num_rows);
+    return 0;
+}
+
+static int convert_chunks(CacheRun* run, const CacheOptions* options, FILE* file) {
+    CacheChunker chunker;
+    cache_chunker_init(&chunker, CACHE_CHUNK_MIN, CACHE_CHUNK_MAX, CACHE_CHUNK_BITS);
+
+    size_t capacity = CACHE_BLOCK_SIZE;
+    char* block = malloc(capacity);
+    if (!block) return -1;
+
+    int result = 0;
+    int first_block = 1;
+    int at_eof = 0;
+    size_t length = 0;
+    size_t start = 0;           // start of the current chunk in block
+    while (result == 0) {
+        size_t chunk = cache_chunker_next(&chunker, block + start, length - start, at_eof);
+        if (chunk > 0) {
+            result = convert_chunk(run, options, block + start, chunk);
+            start += chunk;
+            continue;
+        }
+        if (at_eof) break;
+
+        // Keep the partial chunk and read more behind it
+        memmove(block, block + start, length - start);
+        length -= start;
+        start = 0;
+        if (length == capacity) {
+            // One record larger than the block: grow until it fits
+            char* new_block = realloc(block, capacity * 2);
+            if (!new_block) {
+                result = -1;
+                break;
+            }
+            block = new_block;
+            capacity *= 2;
+        }
+        length += fread(block + length, 1, capacity - length, file);
+        at_eof = length < capacity;
+        if (ferror(file)) {
+            fprintf(stderr, "Error: Read failed\n");
+            result = -1;
+        }
+        if (first_block && length >= 3 && memcmp(block, UTF8_BOM, 3) == 0) start = 3;
+        first_block = 0;
+    }
+
+    free(block);
+    return result;
+}
+
+int convert_cached(const char* filename, const CacheOptions* options) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+        return -1;
+    }
+
+    CacheRun run;
+    memset(&run, 0, sizeof(run));
+    run.ndjson = options->format == FORMAT_NDJSON;
+    run.styled = options->styled && !run.ndjson;
+    if (cache_open(&run.cache, options->dir) != 0) {
+        fclose(file);
+        return -1;
+    }
+
+    OutputBuffer out;
+    OutputBuffer pending;
+    run.csv = csv_create();
+    run.copy_buffer = malloc(OUTPUT_BUFFER_SIZE);
+    int result = run.csv && run.copy_buffer ? 0 : -1;
+    if (result == 0) result = output_init(&run.fragment, NULL);
+    if (result == 0) {
+        result = options->async_io ? output_init_async(&out, stdout) : output_init(&out, stdout);
+        if (result != 0) output_free(&run.fragment);
+    }
+    if (result != 0) {
+        cache_close(&run.cache, options->max_bytes);
+        free(run.copy_buffer);
+        free_csv(run.csv);
+        fclose(file);
+        return -1;
+    }
+
+    // Rejected input must not produce partial output, so under the error
+    // policy the document is assembled in memory first, as read_csv() does
+    int hold = utf8_get_policy() == INVALID_UTF8_ERROR;
+    if (hold && output_init(&pending, NULL) != 0) result = -1;
+    run.out = hold ? &pending : &out;
+
+    if (result == 0) {
+        if (!run.ndjson) output_write(run.out, run.styled ? "[\n" : "[", run.styled ? 2 : 1);
+        result = convert_chunks(&run, options, file);
+        if (!run.ndjson) {
+            if (run.styled && run.emitted) output_putc(run.out, '\n');
+            output_write(run.out, "]\n", 2);
+        }
+    }
+    if (hold) {
+        if (result == 0) output_write(&out, pending.data, pending.length);
+        if (pending.error) result = -1;
+        output_free(&pending);
+    }
+
+    if (output_flush(&out) != 0 || out.error) result = -1;
+    output_free(&out);
+    output_free(&run.fragment);
+    cache_close(&run.cache, options->max_bytes);
+    free(run.copy_buffer);
+    free_csv(run.csv);
+    fclose(file);
+    return result;
+}
@@ -1,39 +1,305 @@
 #ifndef CJ_H
 #define CJ_H
 
+#include "platform.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include "platform.h"
+#include <stdint.h>
 
 #define VERSION "0.1.2"
 #define INITIAL_CAPACITY 16
 #define INITIAL_LINE_SIZE 256
+#define OUTPUT_BUFFER_SIZE 65536
+#define READER_BUFFER_SIZE 65536
+#define FOLLOW_BATCH_ROWS 4096
+#define FOLLOW_POLL_INTERVAL_MS 500
+#define SERVE_READ_CHUNK 16384
+#define SERVE_BACKLOG 128
+#define SERVE_MAX_REQUEST (64LL * 1024 * 1024)
+#define SERVE_TIMEOUT_SECONDS 30
+#define SERVE_KEEP_BUFFER (4 * 1024 * 1024)
+#define SERVE_ACCEPT_BACKOFF_MS 100
+#define ASYNC_OUTPUT_BLOCK_SIZE (1024 * 1024)
+#define PROFILE_BLOCK_SIZE (16 * 1024 * 1024)
+#define PROFILE_HLL_BITS 12
+#define PROFILE_BATCH_ROWS 4096
+#define CACHE_BLOCK_SIZE (8 * 1024 * 1024)
+#define CACHE_CHUNK_MIN (16 * 1024)
+#define CACHE_CHUNK_MAX (1024 * 1024)
+#define CACHE_CHUNK_BITS 16                 // a cut point every 64 KiB on average
+#define CACHE_DEFAULT_SIZE (1024LL * 1024 * 1024)
+#define CACHE_FORMAT_VERSION 1              // bump when the rendered output changes
+#define UTF8_BOM "\xEF\xBB\xBF"
+#define UTF8_REPLACEMENT "\xEF\xBF\xBD"     // U+FFFD
+
+// A cell's text, relative to the start of its row in the cell heap
+typedef struct {
+    uint32_t offset;
+    uint32_t length;            // bytes, excluding the terminating NUL
+} CSVCell;
 
+// Packed rows: cell text lives in one heap (NUL-terminated, row after row)
+// and cell (row, col) is cells[row * columns + col], about 8 bytes per cell
+// instead of a pointer and an allocation. Read cells through csv_cell().
 typedef struct {
     char** headers;
-    char*** data;
     int num_headers;
     int num_rows;
     int headers_capacity;
     int rows_capacity;
-    int* field_capacities;
+    int columns;                // cells kept per row: the header count; extra fields are dropped
+    CSVCell* cells;
+    int* field_counts;          // cells kept for each row; short rows have fewer than columns
+    size_t* row_starts;         // heap offset of each row's text
+    char* heap;
+    size_t heap_length;
+    size_t heap_capacity;
+    long long row_base;         // rows dropped by csv_clear_rows(), so error messages count from the input start
 } CSVData;
 
+typedef enum {
+    FORMAT_JSON,
+    FORMAT_NDJSON,
+    FORMAT_MSGPACK,
+    FORMAT_CBOR
+} OutputFormat;
+
+typedef enum {
+    NUMBER_NONE,                // not a number (or is_numeric() accepts it but it has no value, e.g. "-")
+    NUMBER_INTEGER,
+    NUMBER_FLOAT
+} NumberKind;
+
+// What the writers do with input that is not well-formed UTF-8; see utf8_set_policy()
+typedef enum {
+    INVALID_UTF8_REPLACE,       // write U+FFFD for each ill-formed sequence
+    INVALID_UTF8_ERROR,         // reject the record while parsing
+    INVALID_UTF8_PASS           // copy the bytes through unchanged
+} InvalidUTF8Policy;
+
+// Input dialect; see csv_set_dialect()
+typedef struct {
+    char delimiter;
+    char quotes[4];             // quote characters, "" disables quoting
+    int trim;                   // strip spaces and tabs (never the delimiter) around fields
+    int header;                 // first record names the columns; otherwise "1".."N"
+} CSVDialect;
+
+// Buffered record reader over a memory buffer or a FILE*.
+// Memory readers parse data[0..length) in place; file readers refill storage.
+typedef struct {
+    const char* data;
+    size_t length;
+    size_t pos;
+    FILE* file;
+    char* storage;
+    size_t storage_capacity;
+    long long offset;           // stream offset of data[0]
+} CSVReader;
+
+typedef struct AsyncOutput AsyncOutput;
+
+// Buffered writer used by all output paths.
+// With file == NULL the buffer grows in memory instead of flushing.
+// With async set, data is a block owned by async_output.c.
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    FILE* file;
+    int error;
+    AsyncOutput* async;
+} OutputBuffer;
+
+typedef struct {
+    int shard_rows;             // rows per shard (0 = use num_shards)
+    int num_shards;             // fixed shard count (0 = use shard_rows)
+    int styled;
+    OutputFormat format;
+    int async_io;               // write shards through output_init_async()
+    const char* prefix;         // files are named <prefix>.NNNN.<format extension>
+} ShardOptions;
+
+typedef struct {
+    const char* checkpoint;     // file holding the resume byte offset, or NULL
+    int poll_interval_ms;
+} FollowOptions;
+
+typedef struct {
+    const char* socket_path;
+    int num_threads;            // 0 = one per CPU core
+    int styled;
+    OutputFormat format;
+    long long max_request;      // larger requests get an error reply
+    int timeout_seconds;        // deadline per connection, for reading the request and writing the reply
+} ServeOptions;
+
+typedef struct {
+    int num_threads;            // 0 = one per CPU core
+    int styled;
+} ProfileOptions;
+
+typedef struct {
+    const char* dir;            // created if missing
+    long long max_bytes;        // fragments beyond this are evicted, least recently used first
+    int styled;
+    OutputFormat format;        // FORMAT_JSON or FORMAT_NDJSON
+    int async_io;
+} CacheOptions;
+
+// Content-defined chunk boundary scanner of cache mode; pos is relative to
+// the start of the current chunk and the state carries over refills
+typedef struct {
+    uint64_t gear[256];
+    unsigned char is_quote[256];
+    uint64_t hash;
+    int quote_char;
+    int pending;                // a cut point was seen; cut at the next record end
+    size_t pos;
+    size_t min_size;            // no cut points before this many bytes
+    size_t max_size;            // cut at the first record end past this many bytes
+    int cut_bits;               // a cut point every 2^cut_bits bytes on average
+} CacheChunker;
+
+typedef struct {
+    long long head;             // stop after this many rows (0 = no limit)
+    long long count;            // reservoir sample size (0 = off)
+    double rate;                // Bernoulli keep probability in (0, 1] (0 = off)
+    int offsets;                // draw count records at random byte offsets instead of scanning
+    uint64_t seed;
+} SampleOptions;
+
+// Per-column statistics gathered by profile mode; per-thread copies merge exactly
+typedef struct {
+    long long count;            // cells, counting columns missing from short rows as ""
+    long long empty;
+    long long numeric;          // non-empty cells is_numeric() accepts
+    long long integers;         // numeric cells parse_number() reads as integers
+    long long floats;           // ... and as floats
+    long long invalid_utf8;     // non-numeric cells that are not well-formed UTF-8
+    long long total_length;     // bytes over all cells
+    size_t max_length;
+    double min;                 // over integers and floats; set once integers + floats > 0
+    double max;
+    unsigned char hll[1 << PROFILE_HLL_BITS];   // HyperLogLog registers over non-empty values
+} ColumnProfile;
+
+typedef struct {
+    char** names;
+    int num_columns;
+    long long rows;
+    ColumnProfile* columns;
+} CSVProfile;
+
 // Utility functions
 void print_usage(void);
 void print_version(void);
 int is_numeric(const char* str);
+NumberKind parse_number(const char* str, long long* int_value, double* float_value);
+int parse_output_format(const char* name, OutputFormat* format);
+int parse_invalid_utf8_policy(const char* name, InvalidUTF8Policy* policy);
+const char* output_format_extension(OutputFormat format);
+uint64_t hash_bytes(const char* data, size_t length, uint64_t seed);
 
 // CSV parsing functions
 char* read_csv_line(FILE* file);
+char* read_csv_record(FILE* file, int* complete);
 char** parse_csv_line(char* line, int* field_count);
 CSVData* read_csv(const char* filename);
+CSVData* read_csv_buffer(const char* data, size_t length);
+CSVData* csv_create(void);
+int csv_set_headers(CSVData* csv, char* line);
+int csv_set_positional_headers(CSVData* csv, int count);
+int csv_append_row(CSVData* csv, char* line);
+int csv_read_all(CSVData* csv, CSVReader* reader);
+long long csv_read_headers(CSVData* csv, const char* data, size_t length);
+void csv_strip_bom(char* record);
+void csv_clear_rows(CSVData* csv);
+void csv_reset(CSVData* csv);
 void free_csv(CSVData* csv);
+const char* csv_cell(const CSVData* csv, int row, int col);
+size_t csv_cell_length(const CSVData* csv, int row, int col);
+
+// Dialect selection (process-wide; set before any parsing or threads start)
+void csv_dialect_default(CSVDialect* dialect);
+int csv_set_dialect(const CSVDialect* dialect);
+const CSVDialect* csv_get_dialect(void);
+void csv_use_generic_kernel(void);
+const char* csv_kernel_name(void);
+
+// CSV reader functions
+void csv_reader_init_buffer(CSVReader* reader, const char* data, size_t length);
+int csv_reader_init_file(CSVReader* reader, FILE* file);
+char* csv_reader_next(CSVReader* reader, int* complete);
+int csv_reader_skip(CSVReader* reader);
+long long csv_reader_tell(const CSVReader* reader);
+int csv_reader_seek(CSVReader* reader, long long offset);
+void csv_reader_free(CSVReader* reader);
+
+// Output buffer functions
+int output_init(OutputBuffer* out, FILE* file);
+void output_write(OutputBuffer* out, const char* data, size_t length);
+void output_putc(OutputBuffer* out, char c);
+void output_puts(OutputBuffer* out, const char* str);
+int output_flush(OutputBuffer* out);
+void output_free(OutputBuffer* out);
+
+// Asynchronous output backend (vmsplice for pipes, io_uring for files; Linux only)
+int output_init_async(OutputBuffer* out, FILE* file);
+int async_output_submit(OutputBuffer* out, int wait);
+void async_output_close(OutputBuffer* out);
+
+// UTF-8 handling (policy is process-wide; set before any parsing or threads start)
+void utf8_set_policy(InvalidUTF8Policy policy);
+InvalidUTF8Policy utf8_get_policy(void);
+size_t utf8_sequence_length(const char* str, size_t length, int* valid);
+size_t utf8_valid_prefix(const char* str, size_t length);
+size_t utf8_sanitize(OutputBuffer* out, const char* str, size_t length);
+size_t json_plain_prefix(const char* str, size_t length);
 
 // JSON output functions
+void write_json_string(OutputBuffer* out, const char* str, size_t length);
+void write_json_value(OutputBuffer* out, const char* value);
+void write_json_rows(OutputBuffer* out, CSVData* csv, int start, int end, int styled, int ndjson);
+void write_json_fragment(OutputBuffer* out, CSVData* csv, int start, int end, int styled, int ndjson);
+const char* json_fragment_separator(int styled, int ndjson);
+void write_rows(OutputBuffer* out, CSVData* csv, int start, int end, OutputFormat format, int styled);
 void print_json_value(const char* value);
 void print_json(CSVData* csv, int styled);
 
-#endif // CJ_H
\ No newline at end of file
+// Binary output functions (MessagePack / CBOR)
+void write_msgpack_rows(OutputBuffer* out, CSVData* csv, int start, int end);
+void write_cbor_rows(OutputBuffer* out, CSVData* csv, int start, int end);
+
+// Sharded output functions
+int write_shards(CSVData* csv, const ShardOptions* options);
+
+// Follow mode functions
+int follow_csv(const char* filename, const FollowOptions* options);
+
+// Server functions
+int serve(const ServeOptions* options);
+
+// Profile functions
+void column_profile_init(ColumnProfile* column);
+void column_profile_add(ColumnProfile* column, const char* value, size_t length);
+void column_profile_merge(ColumnProfile* into, const ColumnProfile* from);
+double column_profile_distinct(const ColumnProfile* column);
+size_t profile_split_records(const char* data, size_t length, const unsigned char* is_quote,
+                             int at_eof, size_t* bounds, int num_chunks);
+CSVProfile* profile_stream(FILE* file, int num_threads);
+void write_profile_json(OutputBuffer* out, const CSVProfile* profile, int styled);
+void free_profile(CSVProfile* profile);
+int profile_csv(const char* filename, const ProfileOptions* options);
+
+// Head and sampling functions
+CSVData* read_csv_sample(const char* filename, const SampleOptions* options);
+
+// Incremental conversion functions
+void cache_chunker_init(CacheChunker* chunker, size_t min_size, size_t max_size, int cut_bits);
+size_t cache_chunker_next(CacheChunker* chunker, const char* data, size_t length, int at_eof);
+int convert_cached(const char* filename, const CacheOptions* options);
+
+#endif // CJ_H
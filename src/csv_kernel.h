@@ -0,0 +1,187 @@
+// Parser kernel template, included by csv_parser.c once per dialect.
+//
+// Define before including:
+//   KERNEL_NAME(suffix)   prefixes the generated function names
+//   KERNEL_DELIM          field delimiter
+//   KERNEL_IS_QUOTE(c)    non-zero if c is a quote character
+//   KERNEL_IS_TRIM(c)     non-zero if c is trimmed around fields
+//
+// Specialized kernels use constants, so the dialect tests fold into the scan
+// loops; the generic kernel passes lookups into the active dialect instead.
+
+// Record splitter: same rules as read_csv_record(), but copies runs of
+// ordinary bytes straight out of the reader buffer
+static char* KERNEL_NAME(next_record)(CSVReader* reader, int* complete) {
+    if (complete) *complete = 0;
+
+    size_t capacity = INITIAL_LINE_SIZE;
+    char* line = malloc(capacity);
+    if (!line) return NULL;
+
+    size_t length = 0;
+    int c;
+    int quote_char = 0;         // open quote, 0 outside quotes
+
+    for (;;) {
+        const char* data = reader->data;
+        size_t start = reader->pos;
+        size_t end = start;
+        if (quote_char) {
+            while (end < reader->length && data[end] != quote_char) end++;
+        } else {
+            while (end < reader->length && !KERNEL_IS_QUOTE(data[end]) &&
+                   data[end] != '\n' && data[end] != '\r') {
+                end++;
+            }
+        }
+
+        // Room for the run plus a doubled quote plus the terminator
+        size_t run = end - start;
+        if (length + run + 2 >= capacity) {
+            while (length + run + 2 >= capacity) capacity *= 2;
+            char* new_line = realloc(line, capacity);
+            if (!new_line) {
+                free(line);
+                return NULL;
+            }
+            line = new_line;
+        }
+        memcpy(line + length, data + start, run);
+        length += run;
+        reader->pos = end;
+
+        if ((c = READER_GETC(reader)) == EOF) break;
+
+        if (!quote_char && KERNEL_IS_QUOTE(c)) {
+            quote_char = c;
+            line[length++] = (char)c;
+        } else if (quote_char && c == quote_char) {
+            int next_c = READER_GETC(reader);
+            line[length++] = (char)c;
+            if (next_c == quote_char) {
+                line[length++] = (char)next_c;
+            } else {
+                quote_char = 0;
+                if (next_c != EOF) READER_UNGETC(reader);
+            }
+        } else if (!quote_char && (c == '\n' || c == '\r')) {
+            if (c == '\r') {
+                int next_c = READER_GETC(reader);
+                if (next_c != '\n' && next_c != EOF) READER_UNGETC(reader);
+            }
+            if (complete) *complete = 1;
+            break;
+        } else {
+            // First byte after a refill
+            line[length++] = (char)c;
+        }
+    }
+
+    if (length == 0 && c == EOF) {
+        free(line);
+        return NULL;
+    }
+
+    line[length] = '\0';
+    return line;
+}
+
+// Record skipper: finds the same boundary as next_record() without copying.
+// Returns 1 past a record, 0 past one csv_read_all() would drop as empty
+// (no bytes, or a leading NUL) and -1 at the end of the input.
+static int KERNEL_NAME(skip_record)(CSVReader* reader) {
+    int c;
+    int first = -1;             // first byte of the record, -1 before any
+    int quote_char = 0;
+
+    for (;;) {
+        const char* data = reader->data;
+        size_t start = reader->pos;
+        size_t end = start;
+        if (quote_char) {
+            const char* close = memchr(data + start, quote_char, reader->length - start);
+            end = close ? (size_t)(close - data) : reader->length;
+        } else {
+            while (end < reader->length && !KERNEL_IS_QUOTE(data[end]) &&
+                   data[end] != '\n' && data[end] != '\r') {
+                end++;
+            }
+        }
+        if (end > start && first < 0) first = (unsigned char)data[start];
+        reader->pos = end;
+
+        if ((c = READER_GETC(reader)) == EOF) break;
+
+        if (!quote_char && (c == '\n' || c == '\r')) {
+            if (c == '\r') {
+                int next_c = READER_GETC(reader);
+                if (next_c != '\n' && next_c != EOF) READER_UNGETC(reader);
+            }
+            return first > 0;
+        }
+        if (first < 0) first = c;
+        // A doubled quote closes and reopens, which lands in the same state
+        if (!quote_char && KERNEL_IS_QUOTE(c)) {
+            quote_char = c;
+        } else if (quote_char && c == quote_char) {
+            quote_char = 0;
+        }
+    }
+
+    return first < 0 ? -1 : first > 0;
+}
+
+// Field splitter: unquotes in place (the result is never longer than the
+// input) and records each field as a span of line. Stores at most max_cells
+// fields starting at *cursor and leaves *cursor after them, so callers can
+// resume with more room or stop early; returns the number stored, or -1 if
+// the line is too long for 32-bit offsets.
+static int KERNEL_NAME(split_fields)(char* line, char** cursor, CSVCell* cells, int max_cells) {
+    int count = 0;
+    char* ptr = *cursor;
+
+    while (*ptr && count < max_cells) {
+        while (KERNEL_IS_TRIM(*ptr)) ptr++;
+
+        char* start = ptr;
+        char* end;
+        if (KERNEL_IS_QUOTE(*ptr)) {
+            char quote_char = *ptr++;
+            char* out = start;
+            while (*ptr) {
+                if (*ptr == quote_char) {
+                    if (ptr[1] != quote_char) {
+                        ptr++;
+                        break;
+                    }
+                    ptr++;
+                }
+                *out++ = *ptr++;
+            }
+            // Anything between the closing quote and the delimiter is kept as is
+            while (*ptr && *ptr != KERNEL_DELIM) *out++ = *ptr++;
+            end = out;
+        } else {
+            while (*ptr && *ptr != KERNEL_DELIM) ptr++;
+            end = ptr;
+        }
+
+        while (start < end && KERNEL_IS_TRIM(*start)) start++;
+        while (end > start && KERNEL_IS_TRIM(end[-1])) end--;
+        if ((size_t)(end - line) > UINT32_MAX) return -1;
+
+        cells[count].offset = (uint32_t)(start - line);
+        cells[count].length = (uint32_t)(end - start);
+        count++;
+
+        if (*ptr == KERNEL_DELIM) ptr++;
+    }
+
+    *cursor = ptr;
+    return count;
+}
+
+#undef KERNEL_NAME
+#undef KERNEL_DELIM
+#undef KERNEL_IS_QUOTE
+#undef KERNEL_IS_TRIM
@@ -0,0 +1,51 @@
+// Kernel family: instantiates csv_kernel.h for one delimiter with each quote
+// set the options name (cj's default "', RFC 4180's " alone, none) and with
+// trimming on and off. Included by csv_parser.c once per delimiter.
+//
+// Define before including:
+//   FAMILY_NAME(suffix)   prefixes the generated function names
+//   FAMILY_DELIM          field delimiter
+//   FAMILY_IS_TRIM(c)     non-zero if c is trimmed when trimming is on
+//
+// Generated names are FAMILY_NAME(<quotes>_<trim>_<function>), e.g.
+// comma_double_raw_split_fields for --quote '"' --no-trim.
+
+#define KERNEL_NAME(suffix) FAMILY_NAME(both_trim_##suffix)
+#define KERNEL_DELIM FAMILY_DELIM
+#define KERNEL_IS_QUOTE(c) ((c) == '"' || (c) == '\'')
+#define KERNEL_IS_TRIM(c) FAMILY_IS_TRIM(c)
+#include "csv_kernel.h"
+
+#define KERNEL_NAME(suffix) FAMILY_NAME(both_raw_##suffix)
+#define KERNEL_DELIM FAMILY_DELIM
+#define KERNEL_IS_QUOTE(c) ((c) == '"' || (c) == '\'')
+#define KERNEL_IS_TRIM(c) 0
+#include "csv_kernel.h"
+
+#define KERNEL_NAME(suffix) FAMILY_NAME(double_trim_##suffix)
+#define KERNEL_DELIM FAMILY_DELIM
+#define KERNEL_IS_QUOTE(c) ((c) == '"')
+#define KERNEL_IS_TRIM(c) FAMILY_IS_TRIM(c)
+#include "csv_kernel.h"
+
+#define KERNEL_NAME(suffix) FAMILY_NAME(double_raw_##suffix)
+#define KERNEL_DELIM FAMILY_DELIM
+#define KERNEL_IS_QUOTE(c) ((c) == '"')
+#define KERNEL_IS_TRIM(c) 0
+#include "csv_kernel.h"
+
+#define KERNEL_NAME(suffix) FAMILY_NAME(none_trim_##suffix)
+#define KERNEL_DELIM FAMILY_DELIM
+#define KERNEL_IS_QUOTE(c) 0
+#define KERNEL_IS_TRIM(c) FAMILY_IS_TRIM(c)
+#include "csv_kernel.h"
+
+#define KERNEL_NAME(suffix) FAMILY_NAME(none_raw_##suffix)
+#define KERNEL_DELIM FAMILY_DELIM
+#define KERNEL_IS_QUOTE(c) 0
+#define KERNEL_IS_TRIM(c) 0
+#include "csv_kernel.h"
+
+#undef FAMILY_NAME
+#undef FAMILY_DELIM
+#undef FAMILY_IS_TRIM
@@ -1,6 +1,20 @@
 #include "cj.h"
 
-char* read_csv_line(FILE* file) {
+#define CLASS_QUOTE 1
+#define CLASS_TRIM 2
+
+// Active dialect, chosen once at startup by csv_set_dialect()
+static CSVDialect active_dialect = { ',', "\"'", 1, 1 };
+static unsigned char dialect_class[256] = {
+    [' '] = CLASS_TRIM, ['\t'] = CLASS_TRIM, ['"'] = CLASS_QUOTE, ['\''] = CLASS_QUOTE
+};
+
+#define DIALECT_IS_QUOTE(c) (dialect_class[(unsigned char)(c)] & CLASS_QUOTE)
+#define DIALECT_IS_TRIM(c) (dialect_class[(unsigned char)(c)] & CLASS_TRIM)
+
+char* read_csv_record(FILE* file, int* complete) {
+    if (complete) *complete = 0;
+    
     size_t capacity = INITIAL_LINE_SIZE;
     char* line = malloc(capacity);
     if (!line) return NULL;
@@ -11,7 +25,8 @@ char* read_csv_line(FILE* file) {
     char quote_char = 0;
     
     while ((c = fgetc(file)) != EOF) {
-        if (length >= capacity - 1) {
+        // Room for up to two bytes (doubled quote) plus the terminator
+        if (length + 2 >= capacity) {
             capacity *= 2;
             char* new_line = realloc(line, capacity);
             if (!new_line) {
@@ -21,7 +36,7 @@ char* read_csv_line(FILE* file) {
             line = new_line;
         }
         
-        if (!in_quotes && (c == '"' || c == '\'')) {
+        if (!in_quotes && DIALECT_IS_QUOTE(c)) {
             in_quotes = 1;
             quote_char = c;
             line[length++] = c;
@@ -44,6 +59,7 @@ char* read_csv_line(FILE* file) {
                     ungetc(next_c, file);
                 }
             }
+            if (complete) *complete = 1;
             break;
         } else {
             line[length++] = c;
@@ -59,230 +75,585 @@ char* read_csv_line(FILE* file) {
     return line;
 }
 
-char** parse_csv_line(char* line, int* field_count) {
-    size_t capacity = INITIAL_CAPACITY;
-    char** fields = malloc(capacity * sizeof(char*));
-    if (!fields) return NULL;
+char* read_csv_line(FILE* file) {
+    return read_csv_record(file, NULL);
+}
+
+void csv_reader_init_buffer(CSVReader* reader, const char* data, size_t length) {
+    reader->data = data;
+    reader->length = length;
+    reader->pos = 0;
+    reader->file = NULL;
+    reader->storage = NULL;
+    reader->storage_capacity = 0;
+    reader->offset = 0;
+}
+
+int csv_reader_init_file(CSVReader* reader, FILE* file) {
+    csv_reader_init_buffer(reader, NULL, 0);
+    reader->storage = malloc(READER_BUFFER_SIZE);
+    if (!reader->storage) return -1;
+    reader->storage_capacity = READER_BUFFER_SIZE;
+    reader->data = reader->storage;
+    reader->file = file;
+    return 0;
+}
+
+void csv_reader_free(CSVReader* reader) {
+    free(reader->storage);
+    reader->storage = NULL;
+    reader->storage_capacity = 0;
+}
+
+long long csv_reader_tell(const CSVReader* reader) {
+    return reader->offset + (long long)reader->pos;
+}
+
+int csv_reader_seek(CSVReader* reader, long long offset) {
+    if (!reader->file) {
+        if (offset < 0 || (size_t)offset > reader->length) return -1;
+        reader->pos = (size_t)offset;
+        return 0;
+    }
     
-    *field_count = 0;
-    char* ptr = line;
+    // Drop buffered bytes; clearing EOF lets follow mode pick up appended data
+    clearerr(reader->file);
+    if (cj_fseek(reader->file, offset, SEEK_SET) != 0) return -1;
+    reader->offset = offset;
+    reader->length = 0;
+    reader->pos = 0;
+    return 0;
+}
+
+static int reader_getc_slow(CSVReader* reader) {
+    if (!reader->file) return EOF;
     
-    while (*ptr) {
-        if ((size_t)*field_count >= capacity) {
-            capacity *= 2;
-            char** new_fields = realloc(fields, capacity * sizeof(char*));
-            if (!new_fields) {
-                for (int i = 0; i < *field_count; i++) {
-                    free(fields[i]);
-                }
-                free(fields);
-                return NULL;
-            }
-            fields = new_fields;
-        }
-        
-        while (*ptr == ' ' || *ptr == '\t') ptr++;
-        
-        size_t field_capacity = INITIAL_LINE_SIZE;
-        char* field = malloc(field_capacity);
-        if (!field) {
-            for (int i = 0; i < *field_count; i++) {
-                free(fields[i]);
-            }
-            free(fields);
-            return NULL;
-        }
-        
-        size_t field_length = 0;
-        int in_quotes = 0;
-        char quote_char = 0;
-        
-        if (*ptr == '"' || *ptr == '\'') {
-            quote_char = *ptr;
-            in_quotes = 1;
-            ptr++;
-        }
-        
-        while (*ptr && (in_quotes || *ptr != ',')) {
-            if (in_quotes && *ptr == quote_char) {
-                if (*(ptr + 1) == quote_char) {
-                    if (field_length >= field_capacity - 1) {
-                        field_capacity *= 2;
-                        char* new_field = realloc(field, field_capacity);
-                        if (!new_field) {
-                            free(field);
-                            for (int i = 0; i < *field_count; i++) {
-                                free(fields[i]);
-                            }
-                            free(fields);
-                            return NULL;
-                        }
-                        field = new_field;
-                    }
-                    field[field_length++] = *ptr;
-                    ptr += 2;
-                } else {
-                    in_quotes = 0;
-                    ptr++;
-                    continue;
-                }
-            } else {
-                if (field_length >= field_capacity - 1) {
-                    field_capacity *= 2;
-                    char* new_field = realloc(field, field_capacity);
-                    if (!new_field) {
-                        free(field);
-                        for (int i = 0; i < *field_count; i++) {
-                            free(fields[i]);
-                        }
-                        free(fields);
-                        return NULL;
-                    }
-                    field = new_field;
-                }
-                
-                field[field_length++] = *ptr;
-                ptr++;
-            }
+    reader->offset += (long long)reader->length;
+    reader->length = fread(reader->storage, 1, reader->storage_capacity, reader->file);
+    reader->pos = 0;
+    if (reader->length == 0) return EOF;
+    return (unsigned char)reader->data[reader->pos++];
+}
+
+// Refill only happens once the buffer is exhausted, so the byte before pos
+// is always still buffered and a one-byte pushback is just pos--
+#define READER_GETC(r) ((r)->pos < (r)->length ? (unsigned char)(r)->data[(r)->pos++] : reader_getc_slow(r))
+#define READER_UNGETC(r) ((r)->pos--)
+
+static void free_fields(char** fields, int count) {
+    for (int i = 0; i < count; i++) {
+        free(fields[i]);
+    }
+    free(fields);
+}
+
+// Default cj dialect: comma, either quote character, trim spaces and tabs
+#define FAMILY_NAME(suffix) comma_##suffix
+#define FAMILY_DELIM ','
+#define FAMILY_IS_TRIM(c) ((c) == ' ' || (c) == '\t')
+#include "csv_kernel_family.h"
+
+// Tabs are field separators here, so only spaces are trimmed
+#define FAMILY_NAME(suffix) tab_##suffix
+#define FAMILY_DELIM '\t'
+#define FAMILY_IS_TRIM(c) ((c) == ' ')
+#include "csv_kernel_family.h"
+
+#define FAMILY_NAME(suffix) pipe_##suffix
+#define FAMILY_DELIM '|'
+#define FAMILY_IS_TRIM(c) ((c) == ' ' || (c) == '\t')
+#include "csv_kernel_family.h"
+
+#define FAMILY_NAME(suffix) semicolon_##suffix
+#define FAMILY_DELIM ';'
+#define FAMILY_IS_TRIM(c) ((c) == ' ' || (c) == '\t')
+#include "csv_kernel_family.h"
+
+// Any other combination of delimiter, quotes and trimming
+#define KERNEL_NAME(suffix) generic_##suffix
+#define KERNEL_DELIM active_dialect.delimiter
+#define KERNEL_IS_QUOTE(c) DIALECT_IS_QUOTE(c)
+#define KERNEL_IS_TRIM(c) DIALECT_IS_TRIM(c)
+#include "csv_kernel.h"
+
+typedef struct {
+    const char* name;
+    char delimiter;
+    const char* quotes;
+    int trim;
+    char* (*next_record)(CSVReader* reader, int* complete);
+    int (*skip_record)(CSVReader* reader);
+    int (*split_fields)(char* line, char** cursor, CSVCell* cells, int max_cells);
+} CSVKernel;
+
+#define KERNEL_ENTRY(name, delimiter, quotes, trim, prefix) \
+    { name, delimiter, quotes, trim, prefix##_next_record, prefix##_skip_record, prefix##_split_fields }
+
+// The six kernels csv_kernel_family.h generates for one delimiter
+#define KERNEL_FAMILY(name, delimiter, prefix) \
+    KERNEL_ENTRY(name, delimiter, "\"'", 1, prefix##_both_trim), \
+    KERNEL_ENTRY(name "-notrim", delimiter, "\"'", 0, prefix##_both_raw), \
+    KERNEL_ENTRY(name "-dquote", delimiter, "\"", 1, prefix##_double_trim), \
+    KERNEL_ENTRY(name "-dquote-notrim", delimiter, "\"", 0, prefix##_double_raw), \
+    KERNEL_ENTRY(name "-noquote", delimiter, "", 1, prefix##_none_trim), \
+    KERNEL_ENTRY(name "-noquote-notrim", delimiter, "", 0, prefix##_none_raw)
+
+static const CSVKernel kernels[] = {
+    KERNEL_FAMILY("comma", ',', comma),
+    KERNEL_FAMILY("tab", '\t', tab),
+    KERNEL_FAMILY("pipe", '|', pipe),
+    KERNEL_FAMILY("semicolon", ';', semicolon),
+};
+
+static const CSVKernel generic_kernel = {
+    "generic", 0, NULL, 0, generic_next_record, generic_skip_record, generic_split_fields
+};
+
+static const CSVKernel* active_kernel = &kernels[0];
+
+void csv_dialect_default(CSVDialect* dialect) {
+    dialect->delimiter = ',';
+    strcpy(dialect->quotes, "\"'");
+    dialect->trim = 1;
+    dialect->header = 1;
+}
+
+// ASCII only, so kernels can compare plain char values
+static int dialect_char_valid(char c) {
+    unsigned char u = (unsigned char)c;
+    return u > 0 && u < 128 && c != '\n' && c != '\r';
+}
+
+int csv_set_dialect(const CSVDialect* dialect) {
+    if (!dialect_char_valid(dialect->delimiter) || strchr(dialect->quotes, dialect->delimiter)) {
+        fprintf(stderr, "Error: Invalid delimiter\n");
+        return -1;
+    }
+    for (const char* q = dialect->quotes; *q; q++) {
+        if (!dialect_char_valid(*q)) {
+            fprintf(stderr, "Error: Invalid quote character\n");
+            return -1;
         }
-        
-        field[field_length] = '\0';
-        
-        char* trimmed_field = field;
-        while (*trimmed_field == ' ' || *trimmed_field == '\t') trimmed_field++;
-        char* end = trimmed_field + strlen(trimmed_field) - 1;
-        while (end >= trimmed_field && (*end == ' ' || *end == '\t')) {
-            *end = '\0';
-            end--;
+    }
+
+    active_dialect = *dialect;
+    memset(dialect_class, 0, sizeof(dialect_class));
+    for (const char* q = dialect->quotes; *q; q++) {
+        dialect_class[(unsigned char)*q] |= CLASS_QUOTE;
+    }
+    if (dialect->trim) {
+        // Never trim the delimiter itself (e.g. tabs in TSV)
+        if (dialect->delimiter != ' ') dialect_class[' '] |= CLASS_TRIM;
+        if (dialect->delimiter != '\t') dialect_class['\t'] |= CLASS_TRIM;
+    }
+
+    active_kernel = &generic_kernel;
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        if (kernels[i].delimiter == dialect->delimiter && kernels[i].trim == dialect->trim &&
+            strcmp(kernels[i].quotes, dialect->quotes) == 0) {
+            active_kernel = &kernels[i];
+            break;
         }
-        
-        fields[*field_count] = malloc(strlen(trimmed_field) + 1);
-        if (!fields[*field_count]) {
-            free(field);
-            for (int i = 0; i < *field_count; i++) {
-                free(fields[i]);
-            }
-            free(fields);
-            return NULL;
+    }
+    return 0;
+}
+
+// Same results as the specialized kernel; lets tests compare the two
+void csv_use_generic_kernel(void) {
+    active_kernel = &generic_kernel;
+}
+
+const CSVDialect* csv_get_dialect(void) {
+    return &active_dialect;
+}
+
+const char* csv_kernel_name(void) {
+    return active_kernel->name;
+}
+
+char* csv_reader_next(CSVReader* reader, int* complete) {
+    return active_kernel->next_record(reader, complete);
+}
+
+// Moves past the next record without copying or splitting it
+int csv_reader_skip(CSVReader* reader) {
+    return active_kernel->skip_record(reader);
+}
+
+// Splits all of line into *cells (allocated, INITIAL_CAPACITY or more);
+// returns the field count or -1
+static int split_all_fields(char* line, CSVCell** cells) {
+    int capacity = INITIAL_CAPACITY;
+    int count = 0;
+    char* cursor = line;
+    *cells = malloc(capacity * sizeof(CSVCell));
+    if (!*cells) return -1;
+
+    for (;;) {
+        int stored = active_kernel->split_fields(line, &cursor, *cells + count, capacity - count);
+        if (stored < 0) break;
+        count += stored;
+        if (*cursor == '\0') return count;
+
+        CSVCell* grown = realloc(*cells, capacity * 2 * sizeof(CSVCell));
+        if (!grown) break;
+        *cells = grown;
+        capacity *= 2;
+    }
+    free(*cells);
+    *cells = NULL;
+    return -1;
+}
+
+// Splits one record into separately allocated fields; line is modified in place
+char** parse_csv_line(char* line, int* field_count) {
+    CSVCell* cells;
+    int count = split_all_fields(line, &cells);
+    if (count < 0) return NULL;
+
+    char** fields = malloc((count > 0 ? count : 1) * sizeof(char*));
+    for (int i = 0; fields && i < count; i++) {
+        fields[i] = malloc(cells[i].length + 1);
+        if (!fields[i]) {
+            free_fields(fields, i);
+            fields = NULL;
+            break;
         }
-        strcpy(fields[*field_count], trimmed_field);
-        free(field);
-        
-        (*field_count)++;
-        
-        if (*ptr == ',') ptr++;
+        memcpy(fields[i], line + cells[i].offset, cells[i].length);
+        fields[i][cells[i].length] = '\0';
     }
-    
+    free(cells);
+    if (fields) *field_count = count;
     return fields;
 }
 
-CSVData* read_csv(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
-        return NULL;
-    }
-    
+CSVData* csv_create(void) {
     CSVData* csv = malloc(sizeof(CSVData));
-    if (!csv) {
-        fclose(file);
-        return NULL;
-    }
+    if (!csv) return NULL;
     
     csv->headers = NULL;
-    csv->data = NULL;
     csv->num_headers = 0;
     csv->num_rows = 0;
     csv->headers_capacity = 0;
     csv->rows_capacity = INITIAL_CAPACITY;
-    csv->field_capacities = NULL;
+    csv->columns = -1;
+    csv->cells = NULL;
+    csv->heap = NULL;
+    csv->heap_length = 0;
+    csv->heap_capacity = 0;
+    csv->row_base = 0;
     
-    char* line = read_csv_line(file);
-    if (line) {
-        csv->headers = parse_csv_line(line, &csv->num_headers);
-        csv->headers_capacity = csv->num_headers;
-        free(line);
-        
-        if (!csv->headers) {
-            free(csv);
-            fclose(file);
-            return NULL;
+    // cells is sized once the column count is known, at the first row
+    csv->field_counts = malloc(csv->rows_capacity * sizeof(int));
+    csv->row_starts = malloc(csv->rows_capacity * sizeof(size_t));
+    if (!csv->field_counts || !csv->row_starts) {
+        free(csv->field_counts);
+        free(csv->row_starts);
+        free(csv);
+        return NULL;
+    }
+    
+    return csv;
+}
+
+// Removes a UTF-8 byte order mark from the start of a document's first record.
+// Done on the record rather than the reader so it works for any refill size.
+void csv_strip_bom(char* record) {
+    if (strncmp(record, UTF8_BOM, 3) == 0) {
+        memmove(record, record + 3, strlen(record + 3) + 1);
+    }
+}
+
+// Under INVALID_UTF8_ERROR records are checked before they are stored, so
+// nothing is written for input that will be rejected
+static int check_utf8(const char* line, const char* what, long long row) {
+    if (utf8_get_policy() != INVALID_UTF8_ERROR) return 0;
+    size_t length = strlen(line);
+    size_t valid = utf8_valid_prefix(line, length);
+    if (valid == length) return 0;
+    if (row > 0) {
+        fprintf(stderr, "Error: Invalid UTF-8 in %s %lld at byte %lu\n", what, row, (unsigned long)valid + 1);
+    } else {
+        fprintf(stderr, "Error: Invalid UTF-8 in %s at byte %lu\n", what, (unsigned long)valid + 1);
+    }
+    return -1;
+}
+
+int csv_set_headers(CSVData* csv, char* line) {
+    if (check_utf8(line, "header", 0) != 0) return -1;
+    csv->headers = parse_csv_line(line, &csv->num_headers);
+    csv->headers_capacity = csv->num_headers;
+    if (!csv->headers) {
+        csv->num_headers = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// Names columns "1".."count" for input without a header record
+int csv_set_positional_headers(CSVData* csv, int count) {
+    csv->headers = malloc((count > 0 ? count : 1) * sizeof(char*));
+    if (!csv->headers) return -1;
+    for (int i = 0; i < count; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "%d", i + 1);
+        csv->headers[i] = strdup(name);
+        if (!csv->headers[i]) {
+            free_fields(csv->headers, i);
+            csv->headers = NULL;
+            return -1;
         }
     }
+    csv->num_headers = count;
+    csv->headers_capacity = count;
+    return 0;
+}
+
+// Fixes the number of cells kept per row and sizes cells for it. Without
+// headers the first row decides, so all of its fields are split up front.
+static int csv_set_columns(CSVData* csv, char* line, int* field_count) {
+    CSVCell* first = NULL;
+    int columns = csv->num_headers;
+    *field_count = -1;
+    if (!csv->headers) {
+        columns = split_all_fields(line, &first);
+        if (columns < 0) return -1;
+        *field_count = columns;
+    }
+
+    CSVCell* cells = realloc(csv->cells, (size_t)csv->rows_capacity * (columns > 0 ? columns : 1) * sizeof(CSVCell));
+    if (!cells) {
+        free(first);
+        return -1;
+    }
+    csv->cells = cells;
+    csv->columns = columns;
+    if (first) memcpy(cells, first, columns * sizeof(CSVCell));
+    free(first);
+    return 0;
+}
+
+static int csv_grow_rows(CSVData* csv) {
+    int new_capacity = csv->rows_capacity * 2;
+    int* new_counts = realloc(csv->field_counts, new_capacity * sizeof(int));
+    if (!new_counts) return -1;
+    csv->field_counts = new_counts;
     
-    csv->data = malloc(csv->rows_capacity * sizeof(char**));
-    csv->field_capacities = malloc(csv->rows_capacity * sizeof(int));
-    if (!csv->data || !csv->field_capacities) {
-        if (csv->headers) {
-            for (int i = 0; i < csv->num_headers; i++) {
-                free(csv->headers[i]);
-            }
-            free(csv->headers);
+    size_t* new_starts = realloc(csv->row_starts, new_capacity * sizeof(size_t));
+    if (!new_starts) return -1;
+    csv->row_starts = new_starts;
+    
+    size_t cells = (size_t)new_capacity * (csv->columns > 0 ? csv->columns : 1);
+    CSVCell* new_cells = realloc(csv->cells, cells * sizeof(CSVCell));
+    if (!new_cells) return -1;
+    csv->cells = new_cells;
+    csv->rows_capacity = new_capacity;
+    return 0;
+}
+
+int csv_append_row(CSVData* csv, char* line) {
+    if (check_utf8(line, "row", csv->row_base + csv->num_rows + 1) != 0) return -1;
+    
+    int field_count = -1;
+    if (csv->columns < 0 && csv_set_columns(csv, line, &field_count) != 0) return -1;
+    if (csv->num_rows >= csv->rows_capacity && csv_grow_rows(csv) != 0) return -1;
+    
+    // Fields past the last column are never output, so they are not split
+    CSVCell* cells = csv->cells + (size_t)csv->num_rows * csv->columns;
+    if (field_count < 0) {
+        char* cursor = line;
+        field_count = active_kernel->split_fields(line, &cursor, cells, csv->columns);
+        if (field_count < 0) {
+            fprintf(stderr, "Error: Row %lld is too long\n", csv->row_base + csv->num_rows + 1);
+            return -1;
         }
-        free(csv->data);
-        free(csv->field_capacities);
-        free(csv);
-        fclose(file);
-        return NULL;
     }
     
-    while ((line = read_csv_line(file)) != NULL) {
-        if (strlen(line) == 0) {
-            free(line);
-            continue;
+    size_t row_length = 0;
+    for (int i = 0; i < field_count; i++) row_length += cells[i].length + 1;
+    if (row_length > UINT32_MAX) {
+        fprintf(stderr, "Error: Row %lld is too long\n", csv->row_base + csv->num_rows + 1);
+        return -1;
+    }
+    if (csv->heap_length + row_length > csv->heap_capacity) {
+        size_t capacity = csv->heap_capacity ? csv->heap_capacity : INITIAL_LINE_SIZE;
+        while (csv->heap_length + row_length > capacity) capacity *= 2;
+        char* heap = realloc(csv->heap, capacity);
+        if (!heap) return -1;
+        csv->heap = heap;
+        csv->heap_capacity = capacity;
+    }
+    
+    // Copy the unquoted fields out of line, back to back
+    size_t start = csv->heap_length;
+    uint32_t offset = 0;
+    for (int i = 0; i < field_count; i++) {
+        char* text = csv->heap + start + offset;
+        memcpy(text, line + cells[i].offset, cells[i].length);
+        text[cells[i].length] = '\0';
+        cells[i].offset = offset;
+        offset += cells[i].length + 1;
+    }
+    
+    csv->row_starts[csv->num_rows] = start;
+    csv->field_counts[csv->num_rows] = field_count;
+    csv->heap_length += row_length;
+    csv->num_rows++;
+    return 0;
+}
+
+// Keeps the heap and row arrays for the next batch
+void csv_clear_rows(CSVData* csv) {
+    csv->row_base += csv->num_rows;
+    csv->num_rows = 0;
+    csv->heap_length = 0;
+}
+
+void csv_reset(CSVData* csv) {
+    csv_clear_rows(csv);
+    if (csv->headers) {
+        for (int i = 0; i < csv->num_headers; i++) {
+            free(csv->headers[i]);
         }
+        free(csv->headers);
+    }
+    csv->headers = NULL;
+    csv->num_headers = 0;
+    csv->headers_capacity = 0;
+    csv->columns = -1;
+    csv->row_base = 0;
+}
+
+int csv_read_all(CSVData* csv, CSVReader* reader) {
+    char* line;
+    
+    int first = !csv->headers && csv_reader_tell(reader) == 0;
+    
+    if (!csv->headers && active_dialect.header) {
+        line = csv_reader_next(reader, NULL);
+        if (!line) return 0;
+        if (first) csv_strip_bom(line);
+        first = 0;
         
-        if (csv->num_rows >= csv->rows_capacity) {
-            csv->rows_capacity *= 2;
-            char*** new_data = realloc(csv->data, csv->rows_capacity * sizeof(char**));
-            int* new_capacities = realloc(csv->field_capacities, csv->rows_capacity * sizeof(int));
-            if (!new_data || !new_capacities) {
-                free(line);
-                break;
-            }
-            csv->data = new_data;
-            csv->field_capacities = new_capacities;
+        int result = csv_set_headers(csv, line);
+        free(line);
+        if (result != 0) return -1;
+    }
+    
+    while ((line = csv_reader_next(reader, NULL)) != NULL) {
+        if (first) {
+            csv_strip_bom(line);
+            first = 0;
         }
-        
-        int field_count;
-        csv->data[csv->num_rows] = parse_csv_line(line, &field_count);
-        csv->field_capacities[csv->num_rows] = field_count;
-        
-        if (!csv->data[csv->num_rows]) {
+        if (line[0] == '\0') {
             free(line);
-            break;
+            continue;
         }
         
-        csv->num_rows++;
+        int result = csv_append_row(csv, line);
+        free(line);
+        if (result != 0) return -1;
+        
+        // Without a header record the first row decides the column count
+        if (!csv->headers && csv_set_positional_headers(csv, csv->columns) != 0) {
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+// Sets the column names from the complete records at the start of
+// data[0..length): the header record or, without one, "1".."N" sized by the
+// first non-empty record, which stays part of the data. Returns the offset
+// where data rows start, or -1 on error; csv->headers stays NULL while no
+// such record has been seen.
+long long csv_read_headers(CSVData* csv, const char* data, size_t length) {
+    CSVReader reader;
+    csv_reader_init_buffer(&reader, data, length);
+
+    if (active_dialect.header) {
+        char* line = csv_reader_next(&reader, NULL);
+        if (!line) return 0;
+        int result = csv_set_headers(csv, line);
         free(line);
+        return result == 0 ? csv_reader_tell(&reader) : -1;
+    }
+
+    long long start = 0;
+    char* line;
+    while ((line = csv_reader_next(&reader, NULL)) != NULL && line[0] == '\0') {
+        free(line);
+        start = csv_reader_tell(&reader);
+    }
+    if (!line) return start;
+
+    int count;
+    char** fields = parse_csv_line(line, &count);
+    free(line);
+    if (!fields) return -1;
+    free_fields(fields, count);
+    return csv_set_positional_headers(csv, count) == 0 ? start : -1;
+}
+
+CSVData* read_csv(const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+        return NULL;
+    }
+    
+    CSVReader reader;
+    CSVData* csv = csv_create();
+    if (!csv || csv_reader_init_file(&reader, file) != 0) {
+        free_csv(csv);
+        fclose(file);
+        return NULL;
     }
     
+    if (csv_read_all(csv, &reader) != 0) {
+        free_csv(csv);
+        csv = NULL;
+    }
+    
+    csv_reader_free(&reader);
     fclose(file);
     return csv;
 }
 
-void free_csv(CSVData* csv) {
-    if (!csv) return;
+CSVData* read_csv_buffer(const char* data, size_t length) {
+    CSVReader reader;
+    csv_reader_init_buffer(&reader, data, length);
     
-    if (csv->headers) {
-        for (int i = 0; i < csv->num_headers; i++) {
-            free(csv->headers[i]);
-        }
-        free(csv->headers);
-    }
+    CSVData* csv = csv_create();
+    if (!csv) return NULL;
     
-    if (csv->data) {
-        for (int i = 0; i < csv->num_rows; i++) {
-            if (csv->data[i]) {
-                for (int j = 0; j < csv->field_capacities[i]; j++) {
-                    free(csv->data[i][j]);
-                }
-                free(csv->data[i]);
-            }
-        }
-        free(csv->data);
+    if (csv_read_all(csv, &reader) != 0) {
+        free_csv(csv);
+        return NULL;
     }
+    return csv;
+}
+
+void free_csv(CSVData* csv) {
+    if (!csv) return;
     
-    free(csv->field_capacities);
+    csv_reset(csv);
+    free(csv->cells);
+    free(csv->field_counts);
+    free(csv->row_starts);
+    free(csv->heap);
     free(csv);
-}
\ No newline at end of file
+}
+
+// Value of a cell; rows shorter than the header row are padded with "".
+// Valid until the next csv_append_row(), which may move the heap.
+const char* csv_cell(const CSVData* csv, int row, int col) {
+    if (col >= csv->field_counts[row]) return "";
+    return csv->heap + csv->row_starts[row] + csv->cells[(size_t)row * csv->columns + col].offset;
+}
+
+size_t csv_cell_length(const CSVData* csv, int row, int col) {
+    if (col >= csv->field_counts[row]) return 0;
+    return csv->cells[(size_t)row * csv->columns + col].length;
+}
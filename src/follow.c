@@ -0,0 +1,258 @@
+#include "cj.h"
+
+#ifdef PLATFORM_LINUX
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    int fd;                     // inotify descriptor, -1 when polling
+} FileWatch;
+
+static void watch_open(FileWatch* watch, const char* filename) {
+    watch->fd = -1;
+#ifdef PLATFORM_LINUX
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) return;
+    if (inotify_add_watch(fd, filename, IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+                                     IN_MOVE_SELF | IN_DELETE_SELF) < 0) {
+        close(fd);
+        return;
+    }
+    watch->fd = fd;
+#else
+    (void)filename;
+#endif
+}
+
+static void watch_wait(FileWatch* watch, int timeout_ms) {
+#ifdef PLATFORM_LINUX
+    if (watch->fd >= 0) {
+        // The timeout doubles as a safety net for events inotify cannot see (e.g. NFS)
+        struct pollfd pfd;
+        pfd.fd = watch->fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, timeout_ms) > 0) {
+            char events[4096];
+            if (read(watch->fd, events, sizeof(events)) < 0) {
+                cj_sleep_ms(timeout_ms);
+            }
+        }
+        return;
+    }
+#endif
+    (void)watch;
+    cj_sleep_ms(timeout_ms);
+}
+
+static void watch_close(FileWatch* watch) {
+#ifdef PLATFORM_LINUX
+    if (watch->fd >= 0) close(watch->fd);
+#endif
+    watch->fd = -1;
+}
+
+static long long load_checkpoint(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+
+    long long offset = -1;
+    if (fscanf(file, "%lld", &offset) != 1) offset = -1;
+    fclose(file);
+    return offset;
+}
+
+static int save_checkpoint(const char* path, long long offset) {
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE* file = fopen(tmp_path, "w");
+    if (!file) return -1;
+    fprintf(file, "%lld\n", offset);
+    if (fclose(file) != 0) return -1;
+
+    // Write-then-rename keeps the previous checkpoint intact if we are killed mid-write
+#ifdef PLATFORM_WINDOWS
+    remove(path);
+#endif
+    return rename(tmp_path, path);
+}
+
+// Moves the file position; callers reposition through csv_reader_seek()
+static long long file_size(FILE* file) {
+    clearerr(file);
+    cj_fseek(file, 0, SEEK_END);
+    return cj_ftell(file);
+}
+
+// Reads the header record, waiting until it has been completely written.
+// Without a header the first record only sets the column count and is re-read as data.
+static int follow_read_headers(CSVReader* reader, CSVData* csv, FileWatch* watch, const FollowOptions* options) {
+    int header = csv_get_dialect()->header;
+    for (;;) {
+        int first = csv_reader_tell(reader) == 0;
+        int complete;
+        char* line = csv_reader_next(reader, &complete);
+        if (line && first) csv_strip_bom(line);
+        if (line && complete && header) {
+            int result = csv_set_headers(csv, line);
+            free(line);
+            return result;
+        }
+        if (line && complete && *line) {
+            int count;
+            char** fields = parse_csv_line(line, &count);
+            free(line);
+            if (!fields) return -1;
+            for (int i = 0; i < count; i++) free(fields[i]);
+            free(fields);
+            csv_reader_seek(reader, 0);
+            return csv_set_positional_headers(csv, count);
+        }
+        if (line && complete) {
+            free(line);
+            continue;
+        }
+        free(line);
+        csv_reader_seek(reader, 0);
+        watch_wait(watch, options->poll_interval_ms);
+    }
+}
+
+static int follow_emit(CSVData* csv, OutputBuffer* out, const FollowOptions* options,
+                       long long offset, long long* saved_offset) {
+    if (csv->num_rows > 0) {
+        write_json_rows(out, csv, 0, csv->num_rows, 0, 1);
+        csv_clear_rows(csv);
+        if (output_flush(out) != 0 || fflush(out->file) != 0) return -1;
+    }
+
+    if (options->checkpoint && offset != *saved_offset) {
+        if (save_checkpoint(options->checkpoint, offset) != 0) {
+            fprintf(stderr, "Error: Cannot write checkpoint '%s'\n", options->checkpoint);
+            return -1;
+        }
+        *saved_offset = offset;
+    }
+    return 0;
+}
+
+// Starts over at the header of filename, reopening it when *file is no longer
+// the file at that path. Columns may differ, so csv is replaced.
+static int follow_restart(const char* filename, FILE** file, CSVReader* reader, CSVData** csv,
+                          FileWatch* watch, const FollowOptions* options) {
+    if (cj_same_file(filename, *file) == 0) {
+        FILE* next = fopen(filename, "rb");
+        CSVReader next_reader;
+        if (!next || csv_reader_init_file(&next_reader, next) != 0) {
+            fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+            if (next) fclose(next);
+            return -1;
+        }
+        csv_reader_free(reader);
+        fclose(*file);
+        *file = next;
+        *reader = next_reader;
+        watch_close(watch);
+        watch_open(watch, filename);
+    }
+
+    CSVData* fresh = csv_create();
+    if (!fresh) return -1;
+    free_csv(*csv);
+    *csv = fresh;
+    csv_reader_seek(reader, 0);
+    return follow_read_headers(reader, fresh, watch, options);
+}
+
+int follow_csv(const char* filename, const FollowOptions* options) {
+    // Binary mode keeps ftell() offsets equal to byte offsets on every platform
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+        return -1;
+    }
+
+    CSVReader reader;
+    CSVData* csv = csv_create();
+    OutputBuffer out;
+    if (!csv || csv_reader_init_file(&reader, file) != 0) {
+        free_csv(csv);
+        fclose(file);
+        return -1;
+    }
+    if (output_init(&out, stdout) != 0) {
+        csv_reader_free(&reader);
+        free_csv(csv);
+        fclose(file);
+        return -1;
+    }
+
+    FileWatch watch;
+    watch_open(&watch, filename);
+
+    int result = follow_read_headers(&reader, csv, &watch, options);
+
+    long long data_start = csv_reader_tell(&reader);
+    long long drained_size = -1;
+    long long offset = data_start;
+    long long saved_offset = -1;
+    if (result == 0 && options->checkpoint) {
+        long long checkpoint = load_checkpoint(options->checkpoint);
+        if (checkpoint > data_start && checkpoint <= file_size(file)) {
+            offset = checkpoint;
+            saved_offset = checkpoint;
+        }
+    }
+    csv_reader_seek(&reader, offset);
+
+    while (result == 0) {
+        int complete;
+        char* line = csv_reader_next(&reader, &complete);
+
+        if (line && complete) {
+            // offset is where this record started; without a header that can be byte 0
+            if (offset == 0) csv_strip_bom(line);
+            offset = csv_reader_tell(&reader);
+            if (*line) result = csv_append_row(csv, line);
+            free(line);
+            if (result == 0 && csv->num_rows >= FOLLOW_BATCH_ROWS) {
+                result = follow_emit(csv, &out, options, offset, &saved_offset);
+            }
+            continue;
+        }
+
+        // Caught up with the writer: hold back any partial trailing record
+        free(line);
+        result = follow_emit(csv, &out, options, offset, &saved_offset);
+        if (result != 0) break;
+
+        // Rotated: finish what the writer put into the old file before the
+        // rename (one more pass after its size stops changing), then switch
+        int rotated = cj_same_file(filename, file) == 0;
+        long long size = file_size(file);
+        if (rotated && size != drained_size) {
+            drained_size = size;
+            csv_reader_seek(&reader, offset);
+            continue;
+        }
+        if (rotated || size < offset) {
+            fprintf(stderr, "Warning: '%s' was %s, re-reading its header\n", filename,
+                    rotated ? "rotated" : "truncated");
+            result = follow_restart(filename, &file, &reader, &csv, &watch, options);
+            data_start = offset = csv_reader_tell(&reader);
+            drained_size = -1;
+            continue;
+        }
+        watch_wait(&watch, options->poll_interval_ms);
+        csv_reader_seek(&reader, offset);
+    }
+
+    watch_close(&watch);
+    output_free(&out);
+    csv_reader_free(&reader);
+    free_csv(csv);
+    fclose(file);
+    return result;
+}
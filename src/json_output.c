@@ -1,68 +1,217 @@
 #include "cj.h"
 
-void print_json_value(const char* value) {
-    if (strlen(value) == 0) {
-        printf("\"\"");
-    } else if (is_numeric(value)) {
-        printf("%s", value);
-    } else {
-        printf("\"");
-        for (const char* p = value; *p; p++) {
-            if (*p == '"') {
-                printf("\\\"");
-            } else if (*p == '\\') {
-                printf("\\\\");
-            } else if (*p == '\n') {
-                printf("\\n");
-            } else if (*p == '\r') {
-                printf("\\r");
-            } else if (*p == '\t') {
-                printf("\\t");
-            } else {
-                printf("%c", *p);
+// Writes str as a JSON string literal. Clean runs are found with
+// json_plain_prefix() and copied in one piece; controls become \u00XX (apart
+// from \n, \r and \t) and ill-formed UTF-8 follows utf8_get_policy().
+void write_json_string(OutputBuffer* out, const char* str, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    int replace = utf8_get_policy() == INVALID_UTF8_REPLACE;
+    size_t run = 0;
+    size_t i = 0;
+
+    output_putc(out, '"');
+    for (;;) {
+        i += json_plain_prefix(str + i, length - i);
+        if (i >= length) break;
+
+        unsigned char c = (unsigned char)str[i];
+        if (c >= 0x80) {
+            // Non-ASCII stays part of the run unless it is ill-formed and replaced
+            while (i < length && (unsigned char)str[i] >= 0x80) {
+                int valid = 1;
+                size_t n = replace ? utf8_sequence_length(str + i, length - i, &valid) : 1;
+                if (!valid) {
+                    output_write(out, str + run, i - run);
+                    output_write(out, UTF8_REPLACEMENT, 3);
+                    run = i + n;
+                }
+                i += n;
             }
+            continue;
+        }
+
+        output_write(out, str + run, i - run);
+        if (c == '"') {
+            output_write(out, "\\\"", 2);
+        } else if (c == '\\') {
+            output_write(out, "\\\\", 2);
+        } else if (c == '\n') {
+            output_write(out, "\\n", 2);
+        } else if (c == '\r') {
+            output_write(out, "\\r", 2);
+        } else if (c == '\t') {
+            output_write(out, "\\t", 2);
+        } else {
+            char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+            output_write(out, escape, 6);
         }
-        printf("\"");
+        run = ++i;
     }
+    output_write(out, str + run, length - run);
+    output_putc(out, '"');
 }
 
-void print_json(CSVData* csv, int styled) {
-    printf("[");
-    if (styled) printf("\n");
-    
-    for (int i = 0; i < csv->num_rows; i++) {
-        if (styled) printf("  ");
-        printf("{");
-        if (styled) printf("\n");
-        
-        int max_fields = csv->field_capacities[i] < csv->num_headers ? 
-                        csv->field_capacities[i] : csv->num_headers;
-        
-        for (int j = 0; j < csv->num_headers; j++) {
-            if (styled) printf("    ");
-            printf("\"%s\": ", csv->headers[j]);
-            
-            if (j < max_fields) {
-                print_json_value(csv->data[i][j]);
-            } else {
-                printf("\"\"");
-            }
-            
-            if (j < csv->num_headers - 1) {
-                printf(",");
-            }
-            if (styled) printf("\n");
+static void write_json_cell(OutputBuffer* out, const char* value, size_t length) {
+    if (length == 0) {
+        output_write(out, "\"\"", 2);
+    } else if (is_numeric(value)) {
+        output_write(out, value, length);
+    } else {
+        write_json_string(out, value, length);
+    }
+}
+
+void write_json_value(OutputBuffer* out, const char* value) {
+    write_json_cell(out, value, strlen(value));
+}
+
+// Header keys, escaped and followed by ": ", rendered once per call rather than
+// once per row. Key j is text.data[j ? ends[j - 1] : 0 .. ends[j]).
+typedef struct {
+    OutputBuffer text;
+    size_t* ends;
+} JsonKeys;
+
+static int json_keys_init(JsonKeys* keys, CSVData* csv) {
+    keys->ends = malloc((csv->num_headers > 0 ? csv->num_headers : 1) * sizeof(size_t));
+    if (!keys->ends || output_init(&keys->text, NULL) != 0) {
+        free(keys->ends);
+        return -1;
+    }
+    for (int j = 0; j < csv->num_headers; j++) {
+        write_json_string(&keys->text, csv->headers[j], strlen(csv->headers[j]));
+        output_write(&keys->text, ": ", 2);
+        keys->ends[j] = keys->text.length;
+    }
+    if (keys->text.error) {
+        output_free(&keys->text);
+        free(keys->ends);
+        return -1;
+    }
+    return 0;
+}
+
+static void json_keys_free(JsonKeys* keys) {
+    output_free(&keys->text);
+    free(keys->ends);
+}
+
+static void write_json_row(OutputBuffer* out, CSVData* csv, const JsonKeys* keys, int row, int styled) {
+    if (styled) output_write(out, "  ", 2);
+    output_putc(out, '{');
+    if (styled) output_putc(out, '\n');
+
+    size_t key_start = 0;
+    for (int j = 0; j < csv->num_headers; j++) {
+        if (styled) output_write(out, "    ", 4);
+        output_write(out, keys->text.data + key_start, keys->ends[j] - key_start);
+        key_start = keys->ends[j];
+
+        write_json_cell(out, csv_cell(csv, row, j), csv_cell_length(csv, row, j));
+
+        if (j < csv->num_headers - 1) {
+            output_putc(out, ',');
         }
-        
-        if (styled) printf("  ");
-        printf("}");
-        
-        if (i < csv->num_rows - 1) {
-            printf(",");
+        if (styled) output_putc(out, '\n');
+    }
+
+    if (styled) output_write(out, "  ", 2);
+    output_putc(out, '}');
+}
+
+// Rows start..end-1 with the separators between them (and NDJSON newlines),
+// but without the enclosing brackets
+static void write_json_run(OutputBuffer* out, CSVData* csv, const JsonKeys* keys,
+                           int start, int end, int styled, int ndjson) {
+    for (int i = start; i < end; i++) {
+        write_json_row(out, csv, keys, i, ndjson ? 0 : styled);
+        if (ndjson) {
+            output_putc(out, '\n');
+        } else if (i < end - 1) {
+            output_putc(out, ',');
+            if (styled) output_putc(out, '\n');
         }
-        if (styled) printf("\n");
     }
-    
-    printf("]");
-    if (styled) printf("\n");
-}
\ No newline at end of file
+}
+
+void write_json_rows(OutputBuffer* out, CSVData* csv, int start, int end, int styled, int ndjson) {
+    JsonKeys keys;
+    if (json_keys_init(&keys, csv) != 0) {
+        out->error = 1;
+        return;
+    }
+
+    if (ndjson) {
+        write_json_run(out, csv, &keys, start, end, 0, 1);
+        json_keys_free(&keys);
+        return;
+    }
+
+    output_putc(out, '[');
+    if (styled) output_putc(out, '\n');
+    write_json_run(out, csv, &keys, start, end, styled, 0);
+    if (styled && end > start) output_putc(out, '\n');
+
+    output_putc(out, ']');
+    if (styled) output_putc(out, '\n');
+    json_keys_free(&keys);
+}
+
+// The rows of a document without its brackets. Fragments of consecutive row
+// ranges joined with json_fragment_separator() give the write_json_rows() body.
+void write_json_fragment(OutputBuffer* out, CSVData* csv, int start, int end, int styled, int ndjson) {
+    JsonKeys keys;
+    if (json_keys_init(&keys, csv) != 0) {
+        out->error = 1;
+        return;
+    }
+    write_json_run(out, csv, &keys, start, end, styled, ndjson);
+    json_keys_free(&keys);
+}
+
+const char* json_fragment_separator(int styled, int ndjson) {
+    if (ndjson) return "";
+    return styled ? ",\n" : ",";
+}
+
+// Writes a complete document the way the command line prints it
+void write_rows(OutputBuffer* out, CSVData* csv, int start, int end, OutputFormat format, int styled) {
+    switch (format) {
+        case FORMAT_MSGPACK:
+            write_msgpack_rows(out, csv, start, end);
+            break;
+        case FORMAT_CBOR:
+            write_cbor_rows(out, csv, start, end);
+            break;
+        case FORMAT_NDJSON:
+            write_json_rows(out, csv, start, end, 0, 1);
+            break;
+        default:
+            write_json_rows(out, csv, start, end, styled, 0);
+            if (!styled) output_putc(out, '\n');
+            break;
+    }
+}
+
+// Called once per value, so it escapes through a stack buffer rather than
+// allocating one: a buffer with a file never grows, it flushes when full
+void print_json_value(const char* value) {
+    char data[256];
+    OutputBuffer out;
+    out.data = data;
+    out.length = 0;
+    out.capacity = sizeof(data);
+    out.file = stdout;
+    out.error = 0;
+    out.async = NULL;
+    write_json_value(&out, value);
+    output_flush(&out);
+}
+
+void print_json(CSVData* csv, int styled) {
+    OutputBuffer out;
+    if (output_init(&out, stdout) != 0) return;
+    write_json_rows(&out, csv, 0, csv->num_rows, styled, 0);
+    output_flush(&out);
+    output_free(&out);
+}
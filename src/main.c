@@ -1,37 +1,367 @@
 #include "cj.h"
+#include <limits.h>
+#include <time.h>
+
+typedef struct {
+    const char* filename;
+    int styled;
+    OutputFormat format;
+    int async_io;
+    int shard_rows;
+    int num_shards;
+    const char* output_prefix;
+    int follow;
+    const char* checkpoint;
+    const char* cache_dir;
+    long long cache_size;
+    SampleOptions sample;
+    int seeded;
+    CSVDialect dialect;
+    InvalidUTF8Policy invalid_utf8;
+} Options;
+
+static int parse_positive_int(const char* str, int* value) {
+    char* end;
+    long parsed = strtol(str, &end, 10);
+    if (*str == '\0' || *end != '\0' || parsed <= 0 || parsed > 1000000000L) {
+        return -1;
+    }
+    *value = (int)parsed;
+    return 0;
+}
+
+static int parse_positive_count(const char* str, long long* value) {
+    char* end;
+    long long parsed = strtoll(str, &end, 10);
+    if (*str == '\0' || *end != '\0' || parsed <= 0 || parsed == LLONG_MAX) {
+        return -1;
+    }
+    *value = parsed;
+    return 0;
+}
+
+// Parses a record count N or a percentage P% in (0, 100]
+static int parse_sample_size(const char* str, SampleOptions* sample) {
+    size_t length = strlen(str);
+    if (length > 1 && str[length - 1] == '%') {
+        char* end;
+        double percent = strtod(str, &end);
+        if (end != str + length - 1 || !(percent > 0 && percent <= 100)) return -1;
+        sample->rate = percent / 100;
+        sample->count = 0;
+        return 0;
+    }
+    sample->rate = 0;
+    return parse_positive_count(str, &sample->count);
+}
+
+// Parses N, NK, NM or NG (multiples of 1024)
+static int parse_byte_size(const char* str, long long* value) {
+    char* end;
+    long long parsed = strtoll(str, &end, 10);
+    long long unit = 1;
+    if (*end == 'K' || *end == 'k') {
+        unit = 1024LL;
+        end++;
+    } else if (*end == 'M' || *end == 'm') {
+        unit = 1024LL * 1024;
+        end++;
+    } else if (*end == 'G' || *end == 'g') {
+        unit = 1024LL * 1024 * 1024;
+        end++;
+    }
+    if (end == str || *end != '\0' || parsed <= 0 || parsed > (1LL << 50) / unit) {
+        return -1;
+    }
+    *value = parsed * unit;
+    return 0;
+}
+
+// Returns 1 if argv[*i] was an input option (advancing *i past its value), 0 if not, -1 if invalid
+static int parse_input_option(int argc, char* argv[], int* i, CSVDialect* dialect, InvalidUTF8Policy* policy) {
+    const char* arg = argv[*i];
+    int has_value = *i + 1 < argc;
+
+    if (strcmp(arg, "--delimiter") == 0 && has_value) {
+        const char* value = argv[++*i];
+        if (strcmp(value, "tab") == 0 || strcmp(value, "\\t") == 0) {
+            dialect->delimiter = '\t';
+        } else if (strlen(value) == 1) {
+            dialect->delimiter = value[0];
+        } else {
+            return -1;
+        }
+    } else if (strcmp(arg, "--quote") == 0 && has_value) {
+        const char* value = argv[++*i];
+        if (strcmp(value, "none") == 0) value = "";
+        if (strlen(value) >= sizeof(dialect->quotes)) return -1;
+        strcpy(dialect->quotes, value);
+    } else if (strcmp(arg, "--no-trim") == 0) {
+        dialect->trim = 0;
+    } else if (strcmp(arg, "--no-header") == 0) {
+        dialect->header = 0;
+    } else if (strcmp(arg, "--invalid-utf8") == 0 && has_value) {
+        if (parse_invalid_utf8_policy(argv[++*i], policy) != 0) return -1;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static int parse_options(int argc, char* argv[], Options* options) {
+    memset(options, 0, sizeof(Options));
+    options->output_prefix = "out";
+    csv_dialect_default(&options->dialect);
+    options->invalid_utf8 = INVALID_UTF8_REPLACE;
+    options->cache_size = CACHE_DEFAULT_SIZE;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = i + 1 < argc;
+
+        int input_option = parse_input_option(argc, argv, &i, &options->dialect, &options->invalid_utf8);
+        if (input_option < 0) return -1;
+        if (input_option > 0) continue;
+
+        if (strcmp(arg, "--styled") == 0 || strcmp(arg, "-s") == 0) {
+            options->styled = 1;
+        } else if (strcmp(arg, "--ndjson") == 0) {
+            options->format = FORMAT_NDJSON;
+        } else if (strcmp(arg, "--format") == 0 && has_value) {
+            if (parse_output_format(argv[++i], &options->format) != 0) return -1;
+        } else if (strcmp(arg, "--io") == 0 && has_value) {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "async") == 0) {
+                options->async_io = 1;
+            } else if (strcmp(mode, "stdio") != 0) {
+                return -1;
+            }
+        } else if (strcmp(arg, "--shard-rows") == 0 && has_value) {
+            if (parse_positive_int(argv[++i], &options->shard_rows) != 0) return -1;
+        } else if (strcmp(arg, "--shards") == 0 && has_value) {
+            if (parse_positive_int(argv[++i], &options->num_shards) != 0) return -1;
+        } else if (strcmp(arg, "--follow") == 0 || strcmp(arg, "-f") == 0) {
+            options->follow = 1;
+        } else if (strcmp(arg, "--checkpoint") == 0 && has_value) {
+            options->checkpoint = argv[++i];
+        } else if ((strcmp(arg, "--output") == 0 || strcmp(arg, "-o") == 0) && has_value) {
+            options->output_prefix = argv[++i];
+        } else if (strcmp(arg, "--cache") == 0 && has_value) {
+            options->cache_dir = argv[++i];
+        } else if (strcmp(arg, "--cache-size") == 0 && has_value) {
+            if (parse_byte_size(argv[++i], &options->cache_size) != 0) return -1;
+        } else if (strcmp(arg, "--head") == 0 && has_value) {
+            if (parse_positive_count(argv[++i], &options->sample.head) != 0) return -1;
+        } else if (strcmp(arg, "--sample") == 0 && has_value) {
+            if (parse_sample_size(argv[++i], &options->sample) != 0) return -1;
+        } else if (strcmp(arg, "--sample-offsets") == 0) {
+            options->sample.offsets = 1;
+        } else if (strcmp(arg, "--seed") == 0 && has_value) {
+            const char* value = argv[++i];
+            char* end;
+            options->sample.seed = strtoull(value, &end, 10);
+            if (*value == '\0' || *value == '-' || *end != '\0') return -1;
+            options->seeded = 1;
+        } else if (strcmp(arg, "--") == 0 && i + 2 == argc && !options->filename) {
+            // The last argument is the file even if it reads as an option or
+            // a command: cj -- serve
+            options->filename = argv[++i];
+        } else if (arg[0] == '-' || options->filename) {
+            return -1;
+        } else {
+            options->filename = arg;
+        }
+    }
+
+    if (!options->filename) return -1;
+    if (options->shard_rows > 0 && options->num_shards > 0) return -1;
+    if (options->checkpoint && !options->follow) return -1;
+    if (options->follow && (options->styled || options->shard_rows > 0 || options->num_shards > 0)) {
+        return -1;
+    }
+    // --follow always streams NDJSON
+    if (options->follow && options->format != FORMAT_JSON && options->format != FORMAT_NDJSON) {
+        return -1;
+    }
+    // Cached fragments are JSON text for a single output document
+    if (options->cache_dir && (options->follow || options->shard_rows > 0 || options->num_shards > 0 ||
+                               (options->format != FORMAT_JSON && options->format != FORMAT_NDJSON))) {
+        return -1;
+    }
+    // Offset draws need a record count to aim for
+    if (options->sample.offsets && options->sample.count == 0) return -1;
+    if ((options->sample.head > 0 || options->sample.count > 0 || options->sample.rate > 0) &&
+        (options->follow || options->cache_dir)) {
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_serve_options(int argc, char* argv[], ServeOptions* options,
+                               CSVDialect* dialect, InvalidUTF8Policy* policy) {
+    memset(options, 0, sizeof(ServeOptions));
+    options->max_request = SERVE_MAX_REQUEST;
+    options->timeout_seconds = SERVE_TIMEOUT_SECONDS;
+    csv_dialect_default(dialect);
+    *policy = INVALID_UTF8_REPLACE;
+
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = i + 1 < argc;
+
+        int input_option = parse_input_option(argc, argv, &i, dialect, policy);
+        if (input_option < 0) return -1;
+        if (input_option > 0) continue;
+
+        if (strcmp(arg, "--socket") == 0 && has_value) {
+            options->socket_path = argv[++i];
+        } else if (strcmp(arg, "--threads") == 0 && has_value) {
+            if (parse_positive_int(argv[++i], &options->num_threads) != 0) return -1;
+        } else if (strcmp(arg, "--max-request") == 0 && has_value) {
+            if (parse_byte_size(argv[++i], &options->max_request) != 0) return -1;
+        } else if (strcmp(arg, "--timeout") == 0 && has_value) {
+            if (parse_positive_int(argv[++i], &options->timeout_seconds) != 0) return -1;
+        } else if (strcmp(arg, "--styled") == 0 || strcmp(arg, "-s") == 0) {
+            options->styled = 1;
+        } else if (strcmp(arg, "--ndjson") == 0) {
+            options->format = FORMAT_NDJSON;
+        } else if (strcmp(arg, "--format") == 0 && has_value) {
+            if (parse_output_format(argv[++i], &options->format) != 0) return -1;
+        } else {
+            return -1;
+        }
+    }
+
+    return options->socket_path ? 0 : -1;
+}
+
+static int parse_profile_options(int argc, char* argv[], ProfileOptions* options,
+                                 const char** filename, CSVDialect* dialect, InvalidUTF8Policy* policy) {
+    memset(options, 0, sizeof(ProfileOptions));
+    csv_dialect_default(dialect);
+    *policy = INVALID_UTF8_REPLACE;
+    *filename = NULL;
+
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = i + 1 < argc;
+
+        int input_option = parse_input_option(argc, argv, &i, dialect, policy);
+        if (input_option < 0) return -1;
+        if (input_option > 0) continue;
+
+        if (strcmp(arg, "--threads") == 0 && has_value) {
+            if (parse_positive_int(argv[++i], &options->num_threads) != 0) return -1;
+        } else if (strcmp(arg, "--styled") == 0 || strcmp(arg, "-s") == 0) {
+            options->styled = 1;
+        } else if (strcmp(arg, "--") == 0 && i + 2 == argc && !*filename) {
+            *filename = argv[++i];
+        } else if (arg[0] != '-' && !*filename) {
+            *filename = arg;
+        } else {
+            return -1;
+        }
+    }
+
+    return *filename ? 0 : -1;
+}
 
 int main(int argc, char* argv[]) {
     if (argc == 1) {
         print_usage();
         return 0;
     }
-    
-    if (argc == 2) {
-        if (strcmp(argv[1], "version") == 0) {
-            print_version();
-            return 0;
-        }
-        
-        CSVData* csv = read_csv(argv[1]);
-        if (!csv) return 1;
-        
-        print_json(csv, 0);
-        printf("\n");
-        free_csv(csv);
+
+    if (argc == 2 && strcmp(argv[1], "version") == 0) {
+        print_version();
         return 0;
     }
-    
-    if (argc == 3) {
-        if (strcmp(argv[1], "--styled") == 0 || strcmp(argv[1], "-s") == 0) {
-            CSVData* csv = read_csv(argv[2]);
-            if (!csv) return 1;
-            
-            print_json(csv, 1);
-            free_csv(csv);
-            return 0;
+
+    if (strcmp(argv[1], "serve") == 0) {
+        ServeOptions serve_options;
+        CSVDialect dialect;
+        InvalidUTF8Policy policy;
+        if (parse_serve_options(argc, argv, &serve_options, &dialect, &policy) != 0) {
+            print_usage();
+            return 1;
         }
+        if (csv_set_dialect(&dialect) != 0) return 1;
+        utf8_set_policy(policy);
+        return serve(&serve_options) == 0 ? 0 : 1;
     }
-    
-    print_usage();
-    return 1;
-}
\ No newline at end of file
+
+    if (strcmp(argv[1], "profile") == 0) {
+        ProfileOptions profile_options;
+        const char* filename;
+        CSVDialect dialect;
+        InvalidUTF8Policy policy;
+        if (parse_profile_options(argc, argv, &profile_options, &filename, &dialect, &policy) != 0) {
+            print_usage();
+            return 1;
+        }
+        if (csv_set_dialect(&dialect) != 0) return 1;
+        utf8_set_policy(policy);
+        return profile_csv(filename, &profile_options) == 0 ? 0 : 1;
+    }
+
+    Options options;
+    if (parse_options(argc, argv, &options) != 0) {
+        print_usage();
+        return 1;
+    }
+    if (csv_set_dialect(&options.dialect) != 0) return 1;
+    utf8_set_policy(options.invalid_utf8);
+
+    if (options.follow) {
+        FollowOptions follow_options;
+        follow_options.checkpoint = options.checkpoint;
+        follow_options.poll_interval_ms = FOLLOW_POLL_INTERVAL_MS;
+        return follow_csv(options.filename, &follow_options) == 0 ? 0 : 1;
+    }
+
+    if (options.cache_dir) {
+        CacheOptions cache_options;
+        cache_options.dir = options.cache_dir;
+        cache_options.max_bytes = options.cache_size;
+        cache_options.styled = options.styled;
+        cache_options.format = options.format;
+        cache_options.async_io = options.async_io;
+        return convert_cached(options.filename, &cache_options) == 0 ? 0 : 1;
+    }
+
+    CSVData* csv;
+    if (options.sample.head > 0 || options.sample.count > 0 || options.sample.rate > 0) {
+        if (!options.seeded) options.sample.seed = (uint64_t)time(NULL);
+        csv = read_csv_sample(options.filename, &options.sample);
+    } else {
+        csv = read_csv(options.filename);
+    }
+    if (!csv) return 1;
+
+    int result = 0;
+    if (options.shard_rows > 0 || options.num_shards > 0) {
+        ShardOptions shard_options;
+        shard_options.shard_rows = options.shard_rows;
+        shard_options.num_shards = options.num_shards;
+        shard_options.styled = options.styled;
+        shard_options.format = options.format;
+        shard_options.async_io = options.async_io;
+        shard_options.prefix = options.output_prefix;
+        result = write_shards(csv, &shard_options) == 0 ? 0 : 1;
+    } else {
+        if (options.format == FORMAT_MSGPACK || options.format == FORMAT_CBOR) {
+            cj_set_binary_mode(stdout);
+        }
+        OutputBuffer out;
+        int initialized = options.async_io ? output_init_async(&out, stdout) : output_init(&out, stdout);
+        if (initialized == 0) {
+            write_rows(&out, csv, 0, csv->num_rows, options.format, options.styled);
+            output_flush(&out);
+        }
+        result = out.error ? 1 : 0;
+        output_free(&out);
+    }
+
+    free_csv(csv);
+    return result;
+}
@@ -0,0 +1,104 @@
+#include "cj.h"
+
+int output_init(OutputBuffer* out, FILE* file) {
+    out->capacity = OUTPUT_BUFFER_SIZE;
+    out->data = malloc(out->capacity);
+    out->length = 0;
+    out->file = file;
+    out->error = 0;
+    out->async = NULL;
+    if (!out->data) {
+        out->capacity = 0;
+        out->error = 1;
+        return -1;
+    }
+    return 0;
+}
+
+static int output_reserve(OutputBuffer* out, size_t length) {
+    size_t capacity = out->capacity;
+    while (capacity - out->length < length) {
+        capacity *= 2;
+    }
+    char* new_data = realloc(out->data, capacity);
+    if (!new_data) {
+        out->error = 1;
+        return -1;
+    }
+    out->data = new_data;
+    out->capacity = capacity;
+    return 0;
+}
+
+// Hands a full buffer to the file; the async backend only waits for an older block
+static int output_spill(OutputBuffer* out) {
+    if (out->async) return async_output_submit(out, 0);
+    return output_flush(out);
+}
+
+void output_write(OutputBuffer* out, const char* data, size_t length) {
+    if (out->error) return;
+
+    if (out->async) {
+        // Async buffers must never be bypassed, so large writes go through in pieces
+        while (out->capacity - out->length < length) {
+            size_t chunk = out->capacity - out->length;
+            memcpy(out->data + out->length, data, chunk);
+            out->length += chunk;
+            data += chunk;
+            length -= chunk;
+            if (output_spill(out) != 0) return;
+        }
+    } else if (out->capacity - out->length < length) {
+        if (!out->file) {
+            if (output_reserve(out, length) != 0) return;
+        } else {
+            if (output_flush(out) != 0) return;
+            if (length >= out->capacity) {
+                if (fwrite(data, 1, length, out->file) != length) {
+                    out->error = 1;
+                }
+                return;
+            }
+        }
+    }
+
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+void output_putc(OutputBuffer* out, char c) {
+    if (out->length < out->capacity) {
+        out->data[out->length++] = c;
+    } else {
+        output_write(out, &c, 1);
+    }
+}
+
+void output_puts(OutputBuffer* out, const char* str) {
+    output_write(out, str, strlen(str));
+}
+
+int output_flush(OutputBuffer* out) {
+    if (out->error) return -1;
+    if (out->async) return async_output_submit(out, 1);
+    if (!out->file || out->length == 0) return 0;
+
+    if (fwrite(out->data, 1, out->length, out->file) != out->length) {
+        out->error = 1;
+        return -1;
+    }
+    out->length = 0;
+    return 0;
+}
+
+void output_free(OutputBuffer* out) {
+    if (out->async) {
+        async_output_close(out);
+    } else {
+        free(out->data);
+    }
+    out->data = NULL;
+    out->length = 0;
+    out->capacity = 0;
+}
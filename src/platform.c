@@ -1,5 +1,20 @@
 #include "platform.h"
 #include <stdio.h>
+#include <stdlib.h>
+
+#ifdef PLATFORM_WINDOWS
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <direct.h>
+#else
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <errno.h>
 
 const char* get_platform_info(void) {
     static char platform_info[128];
@@ -9,4 +24,159 @@ const char* get_platform_info(void) {
              PLATFORM_NAME, ARCH_NAME, PLATFORM_STRING);
     
     return platform_info;
-}
\ No newline at end of file
+}
+
+#ifdef PLATFORM_WINDOWS
+typedef struct {
+    cj_thread_func func;
+    void* arg;
+} ThreadStart;
+
+static DWORD WINAPI thread_trampoline(LPVOID param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.func(start.arg);
+    return 0;
+}
+
+int cj_thread_create(cj_thread_t* thread, cj_thread_func func, void* arg) {
+    ThreadStart* start = malloc(sizeof(ThreadStart));
+    if (!start) return -1;
+    start->func = func;
+    start->arg = arg;
+    
+    HANDLE handle = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (!handle) {
+        free(start);
+        return -1;
+    }
+    *thread = handle;
+    return 0;
+}
+
+int cj_thread_join(cj_thread_t thread) {
+    if (WaitForSingleObject((HANDLE)thread, INFINITE) != WAIT_OBJECT_0) return -1;
+    CloseHandle((HANDLE)thread);
+    return 0;
+}
+
+int cj_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+void cj_sleep_ms(int milliseconds) {
+    Sleep(milliseconds);
+}
+
+void cj_set_binary_mode(FILE* stream) {
+    _setmode(_fileno(stream), _O_BINARY);
+}
+
+int cj_mkdir(const char* path) {
+    return _mkdir(path) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+const char* cj_map_file(const char* path, size_t* length) {
+    *length = 0;
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 ||
+        (unsigned long long)size.QuadPart > (size_t)-1) {
+        CloseHandle(file);
+        return NULL;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return NULL;
+
+    // The view keeps the mapping alive
+    const char* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) return NULL;
+    *length = (size_t)size.QuadPart;
+    return data;
+}
+
+void cj_unmap_file(const char* data, size_t length) {
+    (void)length;
+    if (data) UnmapViewOfFile(data);
+}
+
+int cj_same_file(const char* path, FILE* file) {
+    HANDLE handle = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return -1;
+
+    BY_HANDLE_FILE_INFORMATION named, open;
+    int result = -1;
+    if (GetFileInformationByHandle(handle, &named) &&
+        GetFileInformationByHandle((HANDLE)_get_osfhandle(_fileno(file)), &open)) {
+        result = named.dwVolumeSerialNumber == open.dwVolumeSerialNumber &&
+                 named.nFileIndexHigh == open.nFileIndexHigh &&
+                 named.nFileIndexLow == open.nFileIndexLow;
+    }
+    CloseHandle(handle);
+    return result;
+}
+#else
+int cj_thread_create(cj_thread_t* thread, cj_thread_func func, void* arg) {
+    return pthread_create(thread, NULL, func, arg) == 0 ? 0 : -1;
+}
+
+int cj_thread_join(cj_thread_t thread) {
+    return pthread_join(thread, NULL) == 0 ? 0 : -1;
+}
+
+int cj_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+void cj_sleep_ms(int milliseconds) {
+    struct timespec delay;
+    delay.tv_sec = milliseconds / 1000;
+    delay.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+    nanosleep(&delay, NULL);
+}
+
+void cj_set_binary_mode(FILE* stream) {
+    (void)stream;
+}
+
+int cj_mkdir(const char* path) {
+    return mkdir(path, 0777) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+const char* cj_map_file(const char* path, size_t* length) {
+    *length = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0 ||
+        (unsigned long long)info.st_size > (size_t)-1) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    *length = (size_t)info.st_size;
+    return data;
+}
+
+void cj_unmap_file(const char* data, size_t length) {
+    if (data) munmap((void*)data, length);
+}
+
+int cj_same_file(const char* path, FILE* file) {
+    struct stat named, open;
+    if (stat(path, &named) != 0 || fstat(fileno(file), &open) != 0) return -1;
+    return named.st_dev == open.st_dev && named.st_ino == open.st_ino;
+}
+#endif
@@ -1,6 +1,13 @@
 #ifndef PLATFORM_H
 #define PLATFORM_H
 
+// Expose POSIX/GNU extensions (threads, fileno, sysconf) under -std=c99
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+
 // Platform detection macros
 #ifdef __linux__
     #define PLATFORM_LINUX 1
@@ -127,13 +134,51 @@
     // Windows file path separator
     #define PATH_SEPARATOR "\\"
     #define PATH_SEPARATOR_CHAR '\\'
+    
+    // 64-bit file offsets
+    #define cj_fseek _fseeki64
+    #define cj_ftell _ftelli64
 #else
     // Unix-like systems
     #define PATH_SEPARATOR "/"
     #define PATH_SEPARATOR_CHAR '/'
+    
+    // 64-bit file offsets
+    #define cj_fseek fseeko
+    #define cj_ftell ftello
 #endif
 
+// Threading primitives
+#ifdef PLATFORM_WINDOWS
+    typedef void* cj_thread_t;  // HANDLE
+#else
+    #include <pthread.h>
+    typedef pthread_t cj_thread_t;
+#endif
+
+typedef void* (*cj_thread_func)(void* arg);
+
 // Function to get platform information at runtime
 const char* get_platform_info(void);
 
+// Thread helpers (return 0 on success)
+int cj_thread_create(cj_thread_t* thread, cj_thread_func func, void* arg);
+int cj_thread_join(cj_thread_t thread);
+int cj_cpu_count(void);
+void cj_sleep_ms(int milliseconds);
+
+// Creates a directory; returns 0 if it exists afterwards
+int cj_mkdir(const char* path);
+
+// Maps a regular file read-only; NULL if it is empty or cannot be mapped
+const char* cj_map_file(const char* path, size_t* length);
+void cj_unmap_file(const char* data, size_t length);
+
+// 1 if path still names the open file, 0 if it names another one (the file
+// was rotated), -1 if path cannot be examined
+int cj_same_file(const char* path, FILE* file);
+
+// Stops newline translation on a stream carrying binary output (no-op on POSIX)
+void cj_set_binary_mode(FILE* stream);
+
 #endif // PLATFORM_H
\ No newline at end of file
@@ -0,0 +1,472 @@
+#include "cj.h"
+#include <math.h>
+#include <stdint.h>
+
+// Profile mode: one pass over the input, no JSON rows. The input is read in
+// blocks; each block is cut at record boundaries into one chunk per thread,
+// and every thread folds its chunk into its own ColumnProfile array. The
+// arrays are merged once at the end (counters add, HyperLogLog registers take
+// the maximum), so the result does not depend on the thread count.
+
+#define HLL_REGISTERS (1 << PROFILE_HLL_BITS)
+
+typedef struct {
+    const char* data;           // chunk of the current block
+    size_t length;
+    int num_columns;
+    ColumnProfile* columns;
+    CSVData* csv;               // batch of parsed rows, reused for every chunk
+    long long rows;
+    long long chunk_rows;       // rows of the current chunk
+    long long invalid_row;      // row of the chunk rejected by --invalid-utf8 error, 0 if none
+    size_t invalid_byte;
+    int failed;
+} ProfileWorker;
+
+void column_profile_init(ColumnProfile* column) {
+    memset(column, 0, sizeof(*column));
+}
+
+void column_profile_add(ColumnProfile* column, const char* value, size_t length) {
+    column->count++;
+    column->total_length += (long long)length;
+    if (length > column->max_length) column->max_length = length;
+    if (length == 0) {
+        column->empty++;
+        return;
+    }
+
+    long long int_value;
+    double number;
+    NumberKind kind = parse_number(value, &int_value, &number);
+    if (kind == NUMBER_INTEGER) {
+        column->integers++;
+        number = (double)int_value;
+    } else if (kind == NUMBER_FLOAT) {
+        column->floats++;
+    }
+    if (kind != NUMBER_NONE) {
+        column->numeric++;
+        if (isfinite(number)) {
+            if (column->integers + column->floats == 1 || number < column->min) column->min = number;
+            if (column->integers + column->floats == 1 || number > column->max) column->max = number;
+        }
+    } else if (is_numeric(value)) {
+        column->numeric++;      // "-", "." and friends: numeric to the JSON writer, but no value
+    } else if (utf8_valid_prefix(value, length) != length) {
+        column->invalid_utf8++;
+    }
+
+    // HyperLogLog: the top bits pick a register, which keeps the longest run of leading zeros seen
+    uint64_t hash = hash_bytes(value, length, 0);
+    unsigned int index = (unsigned int)(hash >> (64 - PROFILE_HLL_BITS));
+    uint64_t rest = hash << PROFILE_HLL_BITS;
+    unsigned char rank = 1;
+    while (rank <= 64 - PROFILE_HLL_BITS && !(rest & 0x8000000000000000ULL)) {
+        rank++;
+        rest <<= 1;
+    }
+    if (rank > column->hll[index]) column->hll[index] = rank;
+}
+
+void column_profile_merge(ColumnProfile* into, const ColumnProfile* from) {
+    int into_has_range = into->integers + into->floats > 0;
+    int from_has_range = from->integers + from->floats > 0;
+    if (from_has_range && (!into_has_range || from->min < into->min)) into->min = from->min;
+    if (from_has_range && (!into_has_range || from->max > into->max)) into->max = from->max;
+
+    into->count += from->count;
+    into->empty += from->empty;
+    into->numeric += from->numeric;
+    into->integers += from->integers;
+    into->floats += from->floats;
+    into->invalid_utf8 += from->invalid_utf8;
+    into->total_length += from->total_length;
+    if (from->max_length > into->max_length) into->max_length = from->max_length;
+    for (int i = 0; i < HLL_REGISTERS; i++) {
+        if (from->hll[i] > into->hll[i]) into->hll[i] = from->hll[i];
+    }
+}
+
+// Distinct non-empty values, about 1.6% standard error at 2^12 registers
+double column_profile_distinct(const ColumnProfile* column) {
+    double m = HLL_REGISTERS;
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < HLL_REGISTERS; i++) {
+        sum += ldexp(1.0, -column->hll[i]);
+        if (column->hll[i] == 0) zeros++;
+    }
+    double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+    // Small cardinalities: linear counting over the empty registers is more accurate
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * log(m / zeros);
+    }
+    return estimate;
+}
+
+// Splits data[0..length) at record ends (newline outside quotes) near
+// length * k / num_chunks. Returns the end of the last complete record;
+// at end of input everything is complete. bounds gets num_chunks + 1 offsets.
+size_t profile_split_records(const char* data, size_t length, const unsigned char* is_quote,
+                             int at_eof, size_t* bounds, int num_chunks) {
+    size_t last_end = 0;
+    int next = 1;
+    int quote_char = 0;
+
+    bounds[0] = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (quote_char) {
+            // A doubled quote closes and reopens, which leaves the state unchanged
+            const char* close = memchr(data + i, quote_char, length - i);
+            if (!close) break;
+            i = (size_t)(close - data);
+            quote_char = 0;
+        } else if (is_quote[c]) {
+            quote_char = c;
+        } else if (c == '\n' || c == '\r') {
+            if (c == '\r' && i + 1 < length && data[i + 1] == '\n') i++;
+            last_end = i + 1;
+            while (next < num_chunks && last_end >= length / num_chunks * next) {
+                bounds[next++] = last_end;
+            }
+        }
+    }
+
+    if (at_eof) last_end = length;
+    while (next <= num_chunks) bounds[next++] = last_end;
+    for (int k = 1; k < num_chunks; k++) {
+        if (bounds[k] > last_end) bounds[k] = last_end;
+    }
+    return last_end;
+}
+
+// Folds the batch into the column profiles and empties it
+static void profile_rows(ProfileWorker* worker) {
+    CSVData* csv = worker->csv;
+    for (int i = 0; i < csv->num_rows; i++) {
+        // Extra fields are dropped and missing ones read as empty, as in the JSON output
+        for (int j = 0; j < worker->num_columns; j++) {
+            column_profile_add(&worker->columns[j], csv_cell(csv, i, j), csv_cell_length(csv, i, j));
+        }
+    }
+    worker->rows += csv->num_rows;
+    csv_clear_rows(csv);
+}
+
+static void* profile_worker_main(void* arg) {
+    ProfileWorker* worker = arg;
+    CSVReader reader;
+    csv_reader_init_buffer(&reader, worker->data, worker->length);
+    int reject_invalid = utf8_get_policy() == INVALID_UTF8_ERROR;
+    worker->chunk_rows = 0;
+
+    char* line;
+    while ((line = csv_reader_next(&reader, NULL)) != NULL) {
+        if (line[0] == '\0') {
+            free(line);
+            continue;
+        }
+        worker->chunk_rows++;
+        if (reject_invalid) {
+            // Checked here rather than by csv_append_row(), which cannot
+            // know how many rows the chunks before this one hold
+            size_t length = strlen(line);
+            size_t valid = utf8_valid_prefix(line, length);
+            if (valid != length) {
+                worker->invalid_row = worker->chunk_rows;
+                worker->invalid_byte = valid + 1;
+                worker->failed = 1;
+                free(line);
+                break;
+            }
+        }
+        int result = csv_append_row(worker->csv, line);
+        free(line);
+        if (result != 0) {
+            worker->failed = 1;
+            break;
+        }
+        if (worker->csv->num_rows >= PROFILE_BATCH_ROWS) profile_rows(worker);
+    }
+    profile_rows(worker);
+    return NULL;
+}
+
+static void profile_chunks(ProfileWorker* workers, int num_workers) {
+    cj_thread_t* threads = calloc(num_workers, sizeof(cj_thread_t));
+    int* started = calloc(num_workers, sizeof(int));
+    for (int i = 1; threads && started && i < num_workers; i++) {
+        started[i] = workers[i].length > 0 &&
+                     cj_thread_create(&threads[i], profile_worker_main, &workers[i]) == 0;
+    }
+
+    // The calling thread takes the first chunk, plus any chunk whose thread failed to start
+    for (int i = 0; i < num_workers; i++) {
+        if (!started || !started[i]) profile_worker_main(&workers[i]);
+    }
+    for (int i = 0; started && i < num_workers; i++) {
+        if (started[i]) cj_thread_join(threads[i]);
+    }
+    free(threads);
+    free(started);
+}
+
+// Takes the column names from the complete records at the start of the input.
+// Returns bytes consumed, or -1 on error; *names stays NULL while undecided.
+static long long profile_read_headers(const char* data, size_t length, char*** names, int* num_columns) {
+    CSVData* csv = csv_create();
+    if (!csv) return -1;
+
+    long long consumed = csv_read_headers(csv, data, length);
+    if (consumed >= 0 && csv->headers) {
+        *names = csv->headers;
+        *num_columns = csv->num_headers;
+        csv->headers = NULL;
+        csv->num_headers = 0;
+    }
+    free_csv(csv);
+    return consumed;
+}
+
+CSVProfile* profile_stream(FILE* file, int num_threads) {
+    int num_workers = num_threads > 0 ? num_threads : cj_cpu_count();
+    CSVProfile* profile = calloc(1, sizeof(CSVProfile));
+    ProfileWorker* workers = calloc(num_workers, sizeof(ProfileWorker));
+    size_t* bounds = malloc((num_workers + 1) * sizeof(size_t));
+    size_t capacity = PROFILE_BLOCK_SIZE;
+    char* block = malloc(capacity);
+    if (!profile || !workers || !bounds || !block) {
+        free(profile);
+        free(workers);
+        free(bounds);
+        free(block);
+        return NULL;
+    }
+
+    unsigned char is_quote[256] = { 0 };
+    for (const char* q = csv_get_dialect()->quotes; *q; q++) is_quote[(unsigned char)*q] = 1;
+
+    int failed = 0;
+    int first_block = 1;
+    size_t length = 0;          // bytes in block, starting with the carried-over partial record
+    for (;;) {
+        if (length == capacity) {
+            // One record larger than the block: grow until it fits
+            char* new_block = realloc(block, capacity * 2);
+            if (!new_block) {
+                failed = 1;
+                break;
+            }
+            block = new_block;
+            capacity *= 2;
+        }
+        length += fread(block + length, 1, capacity - length, file);
+        int at_eof = length < capacity;
+        if (ferror(file)) {
+            fprintf(stderr, "Error: Read failed\n");
+            failed = 1;
+            break;
+        }
+
+        size_t start = 0;
+        if (first_block && length >= 3 && memcmp(block, UTF8_BOM, 3) == 0) start = 3;
+        first_block = 0;
+
+        size_t complete = start + profile_split_records(block + start, length - start, is_quote,
+                                                        at_eof, bounds, num_workers);
+        if (!profile->names && complete > start) {
+            long long consumed = profile_read_headers(block + start, complete - start,
+                                                      &profile->names, &profile->num_columns);
+            if (consumed < 0) {
+                failed = 1;
+                break;
+            }
+            start += (size_t)consumed;
+            if (profile->names) {
+                profile->columns = malloc((profile->num_columns > 0 ? profile->num_columns : 1) *
+                                          sizeof(ColumnProfile));
+                for (int i = 0; i < num_workers; i++) {
+                    workers[i].num_columns = profile->num_columns;
+                    workers[i].columns = malloc((profile->num_columns > 0 ? profile->num_columns : 1) *
+                                                sizeof(ColumnProfile));
+                    workers[i].csv = csv_create();
+                    if (!workers[i].columns || !workers[i].csv ||
+                        csv_set_positional_headers(workers[i].csv, profile->num_columns) != 0) {
+                        failed = 1;
+                    }
+                    for (int j = 0; !failed && j < profile->num_columns; j++) {
+                        column_profile_init(&workers[i].columns[j]);
+                    }
+                }
+                if (!profile->columns || failed) {
+                    failed = 1;
+                    break;
+                }
+            }
+            // Re-split what is left after the header
+            complete = start + profile_split_records(block + start, complete - start, is_quote, 1,
+                                                     bounds, num_workers);
+        }
+
+        if (profile->names) {
+            long long rows_before = 0;
+            for (int i = 0; i < num_workers; i++) {
+                workers[i].data = block + start + bounds[i];
+                workers[i].length = bounds[i + 1] - bounds[i];
+                rows_before += workers[i].rows;
+            }
+            profile_chunks(workers, num_workers);
+            for (int i = 0; i < num_workers && !failed; i++) {
+                if (workers[i].invalid_row > 0) {
+                    fprintf(stderr, "Error: Invalid UTF-8 in row %lld at byte %lu\n",
+                            rows_before + workers[i].invalid_row, (unsigned long)workers[i].invalid_byte);
+                }
+                if (workers[i].failed) failed = 1;
+                rows_before += workers[i].chunk_rows;
+            }
+        }
+        if (failed) break;
+
+        // Carry the partial last record over to the next block
+        if (!profile->names && !at_eof) complete = start;
+        memmove(block, block + complete, length - complete);
+        length -= complete;
+        if (at_eof) break;
+    }
+
+    if (!failed && !profile->names) {
+        // No records at all
+        profile->names = malloc(sizeof(char*));
+        profile->columns = malloc(sizeof(ColumnProfile));
+        if (!profile->names || !profile->columns) failed = 1;
+    }
+    for (int j = 0; !failed && j < profile->num_columns; j++) {
+        column_profile_init(&profile->columns[j]);
+        for (int i = 0; i < num_workers; i++) {
+            column_profile_merge(&profile->columns[j], &workers[i].columns[j]);
+        }
+    }
+    for (int i = 0; i < num_workers; i++) {
+        profile->rows += workers[i].rows;
+        free(workers[i].columns);
+        free_csv(workers[i].csv);
+    }
+
+    free(workers);
+    free(bounds);
+    free(block);
+    if (failed) {
+        free_profile(profile);
+        return NULL;
+    }
+    return profile;
+}
+
+void free_profile(CSVProfile* profile) {
+    if (!profile) return;
+    if (profile->names) {
+        for (int j = 0; j < profile->num_columns; j++) free(profile->names[j]);
+        free(profile->names);
+    }
+    free(profile->columns);
+    free(profile);
+}
+
+// Shortest of %.15g/%.17g that reads back as the same double
+static void write_double(OutputBuffer* out, double value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.15g", value);
+    if (strtod(text, NULL) != value) snprintf(text, sizeof(text), "%.17g", value);
+    output_puts(out, text);
+}
+
+static void write_field(OutputBuffer* out, const char* name, int styled, int first) {
+    if (!first) output_putc(out, ',');
+    if (styled) output_write(out, "\n      ", 7);
+    output_putc(out, '"');
+    output_puts(out, name);
+    output_write(out, "\": ", 3);
+}
+
+static void write_count(OutputBuffer* out, const char* name, long long value, int styled) {
+    char text[32];
+    write_field(out, name, styled, 0);
+    snprintf(text, sizeof(text), "%lld", value);
+    output_puts(out, text);
+}
+
+static void write_column(OutputBuffer* out, const char* name, const ColumnProfile* column, int styled) {
+    long long present = column->count - column->empty;
+    int has_range = column->integers + column->floats > 0;
+
+    if (styled) output_write(out, "    ", 4);
+    output_putc(out, '{');
+    write_field(out, "name", styled, 1);
+    write_json_string(out, name, strlen(name));
+    write_count(out, "count", column->count, styled);
+    write_count(out, "empty", column->empty, styled);
+    write_field(out, "empty_rate", styled, 0);
+    write_double(out, column->count ? (double)column->empty / column->count : 0);
+    write_count(out, "numeric", column->numeric, styled);
+    write_field(out, "numeric_rate", styled, 0);
+    write_double(out, present ? (double)column->numeric / present : 0);
+    write_count(out, "integers", column->integers, styled);
+    write_count(out, "floats", column->floats, styled);
+    write_field(out, "min", styled, 0);
+    if (has_range) write_double(out, column->min); else output_puts(out, "null");
+    write_field(out, "max", styled, 0);
+    if (has_range) write_double(out, column->max); else output_puts(out, "null");
+    write_count(out, "max_length", (long long)column->max_length, styled);
+    write_field(out, "mean_length", styled, 0);
+    write_double(out, column->count ? (double)column->total_length / column->count : 0);
+    write_count(out, "invalid_utf8", column->invalid_utf8, styled);
+    write_count(out, "distinct", (long long)(column_profile_distinct(column) + 0.5), styled);
+    if (styled) output_write(out, "\n    ", 5);
+    output_putc(out, '}');
+}
+
+void write_profile_json(OutputBuffer* out, const CSVProfile* profile, int styled) {
+    char text[32];
+    output_putc(out, '{');
+    if (styled) output_write(out, "\n  ", 3);
+    snprintf(text, sizeof(text), "%lld", profile->rows);
+    output_write(out, "\"rows\": ", 8);
+    output_puts(out, text);
+    output_putc(out, ',');
+    if (styled) output_write(out, "\n  ", 3);
+    output_write(out, "\"columns\": [", 12);
+    if (styled && profile->num_columns > 0) output_putc(out, '\n');
+    for (int j = 0; j < profile->num_columns; j++) {
+        write_column(out, profile->names[j], &profile->columns[j], styled);
+        if (j < profile->num_columns - 1) output_putc(out, ',');
+        if (styled) output_putc(out, '\n');
+    }
+    if (styled && profile->num_columns > 0) output_write(out, "  ", 2);
+    output_putc(out, ']');
+    if (styled) output_putc(out, '\n');
+    output_write(out, "}\n", 2);
+}
+
+int profile_csv(const char* filename, const ProfileOptions* options) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+        return -1;
+    }
+
+    CSVProfile* profile = profile_stream(file, options->num_threads);
+    fclose(file);
+    if (!profile) return -1;
+
+    OutputBuffer out;
+    int result = output_init(&out, stdout);
+    if (result == 0) {
+        write_profile_json(&out, profile, options->styled);
+        result = output_flush(&out);
+    }
+    output_free(&out);
+    free_profile(profile);
+    return result;
+}
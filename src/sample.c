@@ -0,0 +1,290 @@
+#include "cj.h"
+#include <limits.h>
+#include <math.h>
+
+// A record kept by the reservoir, with its position in the input
+typedef struct {
+    char* line;
+    long long index;
+} SampledRecord;
+
+typedef struct {
+    CSVReader reader;
+    char* pending;              // record already read ahead (first row without a header)
+    uint64_t random;            // splitmix64 state
+} Sampler;
+
+static uint64_t next_random(Sampler* sampler) {
+    uint64_t z = (sampler->random += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in (0, 1), never 0, so log() stays finite
+static double next_uniform(Sampler* sampler) {
+    return ((double)(next_random(sampler) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// Records to pass over before the next one kept when each is kept with
+// probability p: one geometric draw instead of a coin flip per record
+static long long next_gap(Sampler* sampler, double p) {
+    if (p >= 1.0) return 0;
+    double gap = floor(log(next_uniform(sampler)) / log1p(-p));
+    return gap < 4e18 ? (long long)gap : LLONG_MAX;
+}
+
+// Next non-empty record in input order, or NULL at the end
+static char* sampler_next(Sampler* sampler) {
+    char* line = sampler->pending;
+    sampler->pending = NULL;
+    if (!line) line = csv_reader_next(&sampler->reader, NULL);
+    while (line && line[0] == '\0') {
+        free(line);
+        line = csv_reader_next(&sampler->reader, NULL);
+    }
+    return line;
+}
+
+// Passes over count non-empty records, finding only their boundaries.
+// Returns -1 if the input ends first.
+static int sampler_skip(Sampler* sampler, long long count) {
+    if (count > 0 && sampler->pending) {
+        free(sampler->pending);
+        sampler->pending = NULL;
+        count--;
+    }
+    while (count > 0) {
+        int result = csv_reader_skip(&sampler->reader);
+        if (result < 0) return -1;
+        count -= result;
+    }
+    return 0;
+}
+
+// Sets the column names like csv_read_all(). Without a header record the
+// first non-empty record sizes the columns and stays pending as the first
+// data row. Returns the offset where data rows start, or -1 on error.
+static long long sampler_read_headers(Sampler* sampler, CSVData* csv) {
+    long long start = 0;
+    char* line = csv_reader_next(&sampler->reader, NULL);
+    if (!line) return 0;
+    csv_strip_bom(line);
+
+    if (csv_get_dialect()->header) {
+        int result = csv_set_headers(csv, line);
+        free(line);
+        return result == 0 ? csv_reader_tell(&sampler->reader) : -1;
+    }
+
+    while (line && line[0] == '\0') {
+        free(line);
+        start = csv_reader_tell(&sampler->reader);
+        line = csv_reader_next(&sampler->reader, NULL);
+    }
+    if (!line) return start;
+
+    // parse_csv_line() splits in place, so count the fields on a copy
+    char* copy = strdup(line);
+    int count = 0;
+    char** fields = copy ? parse_csv_line(copy, &count) : NULL;
+    free(copy);
+    if (!fields) {
+        free(line);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) free(fields[i]);
+    free(fields);
+
+    sampler->pending = line;
+    return csv_set_positional_headers(csv, count) == 0 ? start : -1;
+}
+
+static int append_record(CSVData* csv, char* line) {
+    int result = csv_append_row(csv, line);
+    free(line);
+    return result;
+}
+
+static int compare_sampled(const void* a, const void* b) {
+    long long x = ((const SampledRecord*)a)->index;
+    long long y = ((const SampledRecord*)b)->index;
+    return x < y ? -1 : x > y;
+}
+
+static int compare_offsets(const void* a, const void* b) {
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return x < y ? -1 : x > y;
+}
+
+// First rows up to the limit (the head on its own), or a Bernoulli sample
+// with the gaps between kept records skipped unparsed
+static int sample_stream(Sampler* sampler, CSVData* csv, const SampleOptions* options) {
+    double rate = options->rate > 0 ? options->rate : 1.0;
+    for (;;) {
+        if (options->head > 0 && csv->num_rows >= options->head) return 0;
+        if (sampler_skip(sampler, next_gap(sampler, rate)) != 0) return 0;
+        char* line = sampler_next(sampler);
+        if (!line) return 0;
+        if (append_record(csv, line) != 0) return -1;
+    }
+}
+
+// Reservoir of options->count records (Li's Algorithm L): after the
+// reservoir fills, the number of records to pass over before the next
+// replacement is drawn directly, so rejected records are only skipped.
+// Kept records are emitted in input order.
+static int sample_reservoir(Sampler* sampler, CSVData* csv, const SampleOptions* options) {
+    long long k = options->count;
+    size_t capacity = INITIAL_CAPACITY;
+    SampledRecord* reservoir = malloc(capacity * sizeof(SampledRecord));
+    if (!reservoir) return -1;
+
+    int result = 0;
+    long long n = 0;
+    char* line;
+    while (n < k && (line = sampler_next(sampler)) != NULL) {
+        if ((size_t)n == capacity) {
+            SampledRecord* grown = realloc(reservoir, capacity * 2 * sizeof(SampledRecord));
+            if (!grown) {
+                free(line);
+                result = -1;
+                break;
+            }
+            reservoir = grown;
+            capacity *= 2;
+        }
+        reservoir[n].line = line;
+        reservoir[n].index = n;
+        n++;
+    }
+    long long kept = n;
+
+    if (result == 0 && kept == k) {
+        double w = exp(log(next_uniform(sampler)) / (double)k);
+        for (;;) {
+            long long gap = next_gap(sampler, w);
+            if (sampler_skip(sampler, gap) != 0) break;
+            n += gap;
+            if ((line = sampler_next(sampler)) == NULL) break;
+
+            SampledRecord* slot = &reservoir[next_random(sampler) % (uint64_t)k];
+            free(slot->line);
+            slot->line = line;
+            slot->index = n++;
+            w *= exp(log(next_uniform(sampler)) / (double)k);
+        }
+    }
+
+    qsort(reservoir, (size_t)kept, sizeof(SampledRecord), compare_sampled);
+    for (long long i = 0; i < kept; i++) {
+        if (result == 0 && (options->head == 0 || csv->num_rows < options->head)) {
+            result = append_record(csv, reservoir[i].line);
+        } else {
+            free(reservoir[i].line);
+        }
+    }
+    free(reservoir);
+    return result;
+}
+
+// Approximate sample without reading the whole input: each draw is the
+// first record starting at or after a random byte offset. Longer records
+// make their successors likelier, and an offset inside a quoted field with
+// line breaks resynchronises mid-record, so this suits line-per-record data.
+static int sample_offsets(Sampler* sampler, CSVData* csv, const SampleOptions* options,
+                          long long start, long long size) {
+    free(sampler->pending);
+    sampler->pending = NULL;
+    if (size <= start) return 0;
+
+    long long count = options->count;
+    if (options->head > 0 && options->head < count) count = options->head;
+    if (count > size - start) count = size - start;
+    long long* offsets = malloc((size_t)count * sizeof(long long));
+    if (!offsets) return -1;
+    for (long long i = 0; i < count; i++) {
+        offsets[i] = start + (long long)(next_uniform(sampler) * (double)(size - start));
+        if (offsets[i] >= size) offsets[i] = size - 1;
+    }
+    // Sorted draws read forward through the file and come out in input order;
+    // a draw landing in an already used record takes the next one instead
+    qsort(offsets, (size_t)count, sizeof(long long), compare_offsets);
+
+    int result = 0;
+    long long position = start;
+    csv_reader_seek(&sampler->reader, start);
+    for (long long i = 0; i < count && result == 0; i++) {
+        if (offsets[i] > position) {
+            // Finish the record holding the byte before the draw
+            if (csv_reader_seek(&sampler->reader, offsets[i] - 1) != 0 ||
+                csv_reader_skip(&sampler->reader) < 0) {
+                break;
+            }
+        }
+        char* line = sampler_next(sampler);
+        if (!line) break;
+        position = csv_reader_tell(&sampler->reader);
+        result = append_record(csv, line);
+    }
+    free(offsets);
+    return result;
+}
+
+CSVData* read_csv_sample(const char* filename, const SampleOptions* options) {
+    // Offset sampling seeks at random, so it reads through a mapping when it can
+    size_t mapped_length = 0;
+    const char* mapped = options->offsets ? cj_map_file(filename, &mapped_length) : NULL;
+    FILE* file = NULL;
+    if (!mapped) {
+        file = fopen(filename, options->offsets ? "rb" : "r");
+        if (!file) {
+            fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+            return NULL;
+        }
+    }
+
+    Sampler sampler;
+    sampler.pending = NULL;
+    sampler.random = options->seed;
+    CSVData* csv = csv_create();
+    int result = csv ? 0 : -1;
+    if (result == 0 && mapped) {
+        csv_reader_init_buffer(&sampler.reader, mapped, mapped_length);
+    } else if (result == 0 && csv_reader_init_file(&sampler.reader, file) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        free_csv(csv);
+        if (file) fclose(file);
+        cj_unmap_file(mapped, mapped_length);
+        return NULL;
+    }
+
+    long long start = sampler_read_headers(&sampler, csv);
+    if (start < 0) {
+        result = -1;
+    } else if (options->offsets) {
+        long long size = (long long)mapped_length;
+        if (!mapped) {
+            cj_fseek(file, 0, SEEK_END);
+            size = cj_ftell(file);
+        }
+        result = sample_offsets(&sampler, csv, options, start, size);
+    } else if (options->count > 0) {
+        result = sample_reservoir(&sampler, csv, options);
+    } else {
+        result = sample_stream(&sampler, csv, options);
+    }
+
+    free(sampler.pending);
+    csv_reader_free(&sampler.reader);
+    if (file) fclose(file);
+    cj_unmap_file(mapped, mapped_length);
+    if (result != 0) {
+        free_csv(csv);
+        return NULL;
+    }
+    return csv;
+}
@@ -0,0 +1,301 @@
+#include "cj.h"
+
+#ifdef PLATFORM_WINDOWS
+
+int serve(const ServeOptions* options) {
+    (void)options;
+    fprintf(stderr, "Error: serve mode is not supported on this platform\n");
+    return -1;
+}
+
+#else
+
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+// Each worker owns its buffers and reuses them for every connection it
+// accepts; buffers a large request grew past SERVE_KEEP_BUFFER are released
+// afterwards so one big payload does not pin memory for the daemon's lifetime
+typedef struct {
+    int listen_fd;
+    const ServeOptions* options;
+    char* input;
+    size_t input_capacity;
+    CSVData* csv;
+    OutputBuffer out;
+} ServeWorker;
+
+static const char* socket_path_to_remove = NULL;
+
+static void handle_shutdown_signal(int sig) {
+    (void)sig;
+    if (socket_path_to_remove) unlink(socket_path_to_remove);
+    _exit(0);
+}
+
+typedef enum {
+    REQUEST_OK,
+    REQUEST_FAILED,             // read error or out of memory
+    REQUEST_TOO_LARGE,
+    REQUEST_TIMED_OUT
+} RequestStatus;
+
+static double monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// Limits the next blocking read or write (option SO_RCVTIMEO or SO_SNDTIMEO)
+// to the time left before deadline, so a client trickling bytes cannot
+// stretch a connection past it. Returns -1 once the deadline has passed.
+static int arm_timeout(int fd, int option, double deadline) {
+    double left = deadline - monotonic_seconds();
+    if (left <= 0) return -1;
+    struct timeval timeout;
+    timeout.tv_sec = (time_t)left;
+    timeout.tv_usec = (suseconds_t)((left - (double)timeout.tv_sec) * 1e6);
+    // A zero timeval would mean no timeout at all
+    if (timeout.tv_sec == 0 && timeout.tv_usec == 0) timeout.tv_usec = 1;
+    return setsockopt(fd, SOL_SOCKET, option, &timeout, sizeof(timeout));
+}
+
+static RequestStatus read_request(ServeWorker* worker, int fd, double deadline, size_t* length) {
+    size_t max_request = (size_t)worker->options->max_request;
+    *length = 0;
+    for (;;) {
+        if (worker->input_capacity - *length < SERVE_READ_CHUNK) {
+            size_t capacity = worker->input_capacity ? worker->input_capacity * 2 : SERVE_READ_CHUNK * 4;
+            // One byte past the limit tells an oversized request from one that fits exactly
+            if (capacity > max_request + 1) capacity = max_request + 1;
+            if (capacity > worker->input_capacity) {
+                char* new_input = realloc(worker->input, capacity);
+                if (!new_input) return REQUEST_FAILED;
+                worker->input = new_input;
+                worker->input_capacity = capacity;
+            }
+        }
+
+        size_t room = worker->input_capacity - *length;
+        if (room > max_request + 1 - *length) room = max_request + 1 - *length;
+        if (arm_timeout(fd, SO_RCVTIMEO, deadline) != 0) return REQUEST_TIMED_OUT;
+        ssize_t n = read(fd, worker->input + *length, room);
+        if (n == 0) return REQUEST_OK;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return REQUEST_TIMED_OUT;
+            return REQUEST_FAILED;
+        }
+        *length += (size_t)n;
+        if (*length > max_request) return REQUEST_TOO_LARGE;
+    }
+}
+
+static int write_all(int fd, const char* data, size_t length, double deadline) {
+    while (length > 0) {
+        if (arm_timeout(fd, SO_SNDTIMEO, deadline) != 0) return -1;
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+// Failed requests get a one-line "Error: ..." reply instead of a document.
+// It gets a second of its own, since the request may have used up the deadline.
+static void reply_error(int fd, const char* message) {
+    char reply[256];
+    int length = snprintf(reply, sizeof(reply), "Error: %s\n", message);
+    write_all(fd, reply, (size_t)length, monotonic_seconds() + 1);
+}
+
+static size_t csv_footprint(const CSVData* csv) {
+    size_t per_row = sizeof(int) + sizeof(size_t);
+    if (csv->columns > 0) per_row += (size_t)csv->columns * sizeof(CSVCell);
+    return csv->heap_capacity + (size_t)csv->rows_capacity * per_row;
+}
+
+static void release_large_buffers(ServeWorker* worker) {
+    if (worker->input_capacity > SERVE_KEEP_BUFFER) {
+        free(worker->input);
+        worker->input = NULL;
+        worker->input_capacity = 0;
+    }
+    if (worker->out.capacity > SERVE_KEEP_BUFFER) {
+        OutputBuffer out;
+        if (output_init(&out, NULL) == 0) {
+            output_free(&worker->out);
+            worker->out = out;
+        }
+    }
+    if (csv_footprint(worker->csv) > SERVE_KEEP_BUFFER) {
+        CSVData* csv = csv_create();
+        if (csv) {
+            free_csv(worker->csv);
+            worker->csv = csv;
+        }
+    }
+}
+
+// Reads CSV until the client shuts down its write side, then replies in the
+// configured format. The whole exchange has to finish within the timeout.
+static void handle_connection(ServeWorker* worker, int fd) {
+    double deadline = monotonic_seconds() + worker->options->timeout_seconds;
+    size_t length;
+    RequestStatus status = read_request(worker, fd, deadline, &length);
+    if (status == REQUEST_TOO_LARGE) {
+        fprintf(stderr, "Error: Request larger than %lld bytes rejected\n", worker->options->max_request);
+        reply_error(fd, "Request too large");
+        return;
+    }
+    if (status == REQUEST_TIMED_OUT) {
+        fprintf(stderr, "Error: Request timed out\n");
+        reply_error(fd, "Request timed out");
+        return;
+    }
+    if (status != REQUEST_OK) {
+        reply_error(fd, "Cannot read request");
+        return;
+    }
+
+    CSVReader reader;
+    csv_reader_init_buffer(&reader, worker->input, length);
+    csv_reset(worker->csv);
+    if (csv_read_all(worker->csv, &reader) != 0) {
+        // csv_read_all() has already said why on stderr
+        reply_error(fd, "Cannot parse CSV");
+        csv_clear_rows(worker->csv);
+        return;
+    }
+
+    OutputBuffer* out = &worker->out;
+    out->length = 0;
+    out->error = 0;
+    write_rows(out, worker->csv, 0, worker->csv->num_rows,
+               worker->options->format, worker->options->styled);
+
+    if (out->error) {
+        fprintf(stderr, "Error: Cannot render reply\n");
+        reply_error(fd, "Cannot render reply");
+    } else {
+        write_all(fd, out->data, out->length, deadline);
+    }
+    csv_clear_rows(worker->csv);
+}
+
+static void* serve_worker_main(void* arg) {
+    ServeWorker* worker = arg;
+    for (;;) {
+        int fd = accept(worker->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            // Only a broken listening socket is permanent; running out of
+            // descriptors or memory passes once other connections close
+            if (errno == EBADF || errno == EINVAL || errno == ENOTSOCK) return NULL;
+            cj_sleep_ms(SERVE_ACCEPT_BACKOFF_MS);
+            continue;
+        }
+        handle_connection(worker, fd);
+        close(fd);
+        release_large_buffers(worker);
+    }
+}
+
+static int open_listener(const char* path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long '%s'\n", path);
+        return -1;
+    }
+
+    // Replace a stale socket from a previous run, but never an ordinary file
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "Error: '%s' exists and is not a socket\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SERVE_BACKLOG) != 0) {
+        fprintf(stderr, "Error: Cannot listen on '%s': %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int serve(const ServeOptions* options) {
+    int listen_fd = open_listener(options->socket_path);
+    if (listen_fd < 0) return -1;
+
+    socket_path_to_remove = options->socket_path;
+    signal(SIGINT, handle_shutdown_signal);
+    signal(SIGTERM, handle_shutdown_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    int num_workers = options->num_threads > 0 ? options->num_threads : cj_cpu_count();
+    ServeWorker* workers = calloc(num_workers, sizeof(ServeWorker));
+    cj_thread_t* threads = calloc(num_workers, sizeof(cj_thread_t));
+    if (!workers || !threads) {
+        free(workers);
+        free(threads);
+        close(listen_fd);
+        unlink(options->socket_path);
+        return -1;
+    }
+
+    int started = 0;
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].listen_fd = listen_fd;
+        workers[i].options = options;
+        workers[i].csv = csv_create();
+        if (!workers[i].csv || output_init(&workers[i].out, NULL) != 0) break;
+        if (cj_thread_create(&threads[i], serve_worker_main, &workers[i]) != 0) break;
+        started++;
+    }
+
+    if (started == 0) {
+        fprintf(stderr, "Error: Cannot start worker threads\n");
+    }
+
+    // Workers run until a signal handler terminates the process
+    for (int i = 0; i < started; i++) {
+        cj_thread_join(threads[i]);
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        free(workers[i].input);
+        free_csv(workers[i].csv);
+        output_free(&workers[i].out);
+    }
+    free(workers);
+    free(threads);
+    close(listen_fd);
+    unlink(options->socket_path);
+    return -1;
+}
+
+#endif
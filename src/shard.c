@@ -0,0 +1,113 @@
+#include "cj.h"
+
+typedef struct {
+    CSVData* csv;
+    const ShardOptions* options;
+    int num_shards;
+    int first_shard;            // this worker handles first_shard, first_shard + stride, ...
+    int stride;
+    int failed;
+} ShardWorker;
+
+static void shard_range(const ShardWorker* worker, int shard, int* start, int* end) {
+    int rows = worker->csv->num_rows;
+
+    if (worker->options->shard_rows > 0) {
+        long long first = (long long)shard * worker->options->shard_rows;
+        long long last = first + worker->options->shard_rows;
+        *start = first < rows ? (int)first : rows;
+        *end = last < rows ? (int)last : rows;
+    } else {
+        // Spread the remainder over the leading shards so sizes differ by at most one row
+        int base = rows / worker->num_shards;
+        int extra = rows % worker->num_shards;
+        *start = shard * base + (shard < extra ? shard : extra);
+        *end = *start + base + (shard < extra ? 1 : 0);
+    }
+}
+
+static int write_shard(ShardWorker* worker, int shard) {
+    const ShardOptions* options = worker->options;
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.%04d.%s", options->prefix, shard,
+             output_format_extension(options->format));
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot create file '%s'\n", path);
+        return -1;
+    }
+
+    int start, end;
+    shard_range(worker, shard, &start, &end);
+
+    OutputBuffer out;
+    int result = options->async_io ? output_init_async(&out, file) : output_init(&out, file);
+    if (result == 0) {
+        write_rows(&out, worker->csv, start, end, options->format, options->styled);
+        result = output_flush(&out);
+    }
+    output_free(&out);
+
+    if (fclose(file) != 0) result = -1;
+    if (result != 0) {
+        fprintf(stderr, "Error: Failed to write file '%s'\n", path);
+    }
+    return result;
+}
+
+static void* shard_worker_main(void* arg) {
+    ShardWorker* worker = arg;
+    for (int shard = worker->first_shard; shard < worker->num_shards; shard += worker->stride) {
+        if (write_shard(worker, shard) != 0) {
+            worker->failed = 1;
+        }
+    }
+    return NULL;
+}
+
+int write_shards(CSVData* csv, const ShardOptions* options) {
+    int num_shards = options->num_shards;
+    if (options->shard_rows > 0) {
+        num_shards = (int)(((long long)csv->num_rows + options->shard_rows - 1) / options->shard_rows);
+    }
+    if (num_shards < 1) num_shards = 1;
+
+    int num_workers = cj_cpu_count();
+    if (num_workers > num_shards) num_workers = num_shards;
+
+    ShardWorker* workers = calloc(num_workers, sizeof(ShardWorker));
+    cj_thread_t* threads = calloc(num_workers, sizeof(cj_thread_t));
+    int* started = calloc(num_workers, sizeof(int));
+    if (!workers || !threads || !started) {
+        free(workers);
+        free(threads);
+        free(started);
+        return -1;
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].csv = csv;
+        workers[i].options = options;
+        workers[i].num_shards = num_shards;
+        workers[i].first_shard = i;
+        workers[i].stride = num_workers;
+        started[i] = i > 0 && cj_thread_create(&threads[i], shard_worker_main, &workers[i]) == 0;
+    }
+
+    // The calling thread takes the first stripe, plus any stripe whose thread failed to start
+    for (int i = 0; i < num_workers; i++) {
+        if (!started[i]) shard_worker_main(&workers[i]);
+    }
+
+    int result = 0;
+    for (int i = 0; i < num_workers; i++) {
+        if (started[i]) cj_thread_join(threads[i]);
+        if (workers[i].failed) result = -1;
+    }
+
+    free(workers);
+    free(threads);
+    free(started);
+    return result;
+}
@@ -0,0 +1,164 @@
+#include "cj.h"
+#include <stdint.h>
+
+// Text scanning for the output writers. The vector loops only find the first
+// byte that needs attention (a control, '"', '\\' or a non-ASCII byte); the
+// scalar code after them decides what that byte is, so every path gives the
+// same answer and the vector width only changes how fast clean runs go by.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTF8_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define UTF8_NEON 1
+#endif
+
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_HIGH 0x8080808080808080ULL
+// Non-zero if any byte of x is below n (n <= 128); may also flag bytes above a true hit
+#define SWAR_HAS_LESS(x, n) (((x) - SWAR_ONES * (n)) & ~(x) & SWAR_HIGH)
+#define SWAR_HAS_BYTE(x, b) SWAR_HAS_LESS((x) ^ (SWAR_ONES * (b)), 1)
+
+static InvalidUTF8Policy invalid_utf8_policy = INVALID_UTF8_REPLACE;
+
+void utf8_set_policy(InvalidUTF8Policy policy) {
+    invalid_utf8_policy = policy;
+}
+
+InvalidUTF8Policy utf8_get_policy(void) {
+    return invalid_utf8_policy;
+}
+
+static int json_plain_byte(unsigned char c) {
+    return c >= 0x20 && c < 0x80 && c != '"' && c != '\\';
+}
+
+size_t json_plain_prefix(const char* str, size_t length) {
+    size_t i = 0;
+#if defined(UTF8_SSE2)
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(str + i));
+        // Signed compare: bytes >= 0x80 are negative, so one test catches controls and non-ASCII
+        __m128i special = _mm_or_si128(_mm_cmplt_epi8(v, space),
+                                       _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                    _mm_cmpeq_epi8(v, backslash)));
+        if (_mm_movemask_epi8(special)) break;
+    }
+#elif defined(UTF8_NEON)
+    const uint8x16_t space = vdupq_n_u8(0x20);
+    const uint8x16_t high = vdupq_n_u8(0x80);
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t*)str + i);
+        uint8x16_t special = vorrq_u8(vorrq_u8(vcltq_u8(v, space), vcgeq_u8(v, high)),
+                                      vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)));
+        if (vmaxvq_u8(special)) break;
+    }
+#else
+    for (; i + 8 <= length; i += 8) {
+        uint64_t v;
+        memcpy(&v, str + i, sizeof(v));
+        if ((v & SWAR_HIGH) || SWAR_HAS_LESS(v, 0x20) ||
+            SWAR_HAS_BYTE(v, '"') || SWAR_HAS_BYTE(v, '\\')) {
+            break;
+        }
+    }
+#endif
+    while (i < length && json_plain_byte((unsigned char)str[i])) i++;
+    return i;
+}
+
+// Length of the leading run of ASCII bytes
+static size_t ascii_prefix(const char* str, size_t length) {
+    size_t i = 0;
+#if defined(UTF8_SSE2)
+    for (; i + 16 <= length; i += 16) {
+        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(str + i)))) break;
+    }
+#elif defined(UTF8_NEON)
+    for (; i + 16 <= length; i += 16) {
+        if (vmaxvq_u8(vld1q_u8((const uint8_t*)str + i)) >= 0x80) break;
+    }
+#else
+    for (; i + 8 <= length; i += 8) {
+        uint64_t v;
+        memcpy(&v, str + i, sizeof(v));
+        if (v & SWAR_HIGH) break;
+    }
+#endif
+    while (i < length && (unsigned char)str[i] < 0x80) i++;
+    return i;
+}
+
+// Well-formed sequences per Unicode Table 3-7. An ill-formed sequence is
+// measured as its maximal subpart, so each one becomes a single U+FFFD.
+size_t utf8_sequence_length(const char* str, size_t length, int* valid) {
+    const unsigned char* s = (const unsigned char*)str;
+    unsigned char lead = s[0];
+    unsigned char low = 0x80;
+    unsigned char high = 0xbf;
+    size_t need;
+
+    *valid = 0;
+    if (lead < 0x80) {
+        *valid = 1;
+        return 1;
+    } else if (lead < 0xc2) {
+        return 1;               // continuation byte or overlong two-byte lead
+    } else if (lead < 0xe0) {
+        need = 2;
+    } else if (lead < 0xf0) {
+        need = 3;
+        if (lead == 0xe0) low = 0xa0;           // overlong
+        if (lead == 0xed) high = 0x9f;          // surrogates
+    } else if (lead < 0xf5) {
+        need = 4;
+        if (lead == 0xf0) low = 0x90;           // overlong
+        if (lead == 0xf4) high = 0x8f;          // above U+10FFFF
+    } else {
+        return 1;
+    }
+
+    for (size_t i = 1; i < need; i++) {
+        if (i >= length || s[i] < low || s[i] > high) return i;
+        low = 0x80;
+        high = 0xbf;
+    }
+    *valid = 1;
+    return need;
+}
+
+size_t utf8_valid_prefix(const char* str, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        i += ascii_prefix(str + i, length - i);
+        if (i >= length) break;
+        int valid;
+        size_t n = utf8_sequence_length(str + i, length - i, &valid);
+        if (!valid) break;
+        i += n;
+    }
+    return i;
+}
+
+size_t utf8_sanitize(OutputBuffer* out, const char* str, size_t length) {
+    size_t written = 0;
+    size_t i = 0;
+    while (i < length) {
+        size_t run = utf8_valid_prefix(str + i, length - i);
+        if (out) output_write(out, str + i, run);
+        written += run;
+        i += run;
+        if (i >= length) break;
+
+        int valid;
+        i += utf8_sequence_length(str + i, length - i, &valid);
+        if (out) output_write(out, UTF8_REPLACEMENT, 3);
+        written += 3;
+    }
+    return written;
+}
@@ -1,10 +1,39 @@
 #include "cj.h"
+#include <errno.h>
 
 void print_usage() {
     printf("Usage:\n");
     printf("  cj [filename]           Convert CSV to JSON\n");
     printf("  cj version              Show version\n");
     printf("  cj --styled|-s [file]   Convert CSV to formatted JSON\n");
+    printf("  cj --ndjson [file]      Convert CSV to newline-delimited JSON\n");
+    printf("  cj --format FORMAT [file]\n");
+    printf("                          Output json, ndjson, msgpack or cbor\n");
+    printf("  cj --io stdio|async     Write output through stdio (default) or vmsplice/io_uring\n");
+    printf("  cj --delimiter C        Field delimiter: one character or 'tab' (default: ,)\n");
+    printf("  cj --quote CHARS        Quote characters (default: \"') or 'none'\n");
+    printf("  cj --no-trim            Keep spaces and tabs around fields\n");
+    printf("  cj --no-header          Treat the first record as data; keys are 1..N\n");
+    printf("  cj --invalid-utf8 POLICY\n");
+    printf("                          Ill-formed UTF-8: replace (default), error or pass\n");
+    printf("  cj --shards K [file]    Write K JSON files in parallel (out.0000.json, ...)\n");
+    printf("  cj --shard-rows N [file]\n");
+    printf("                          Write JSON files of N rows each in parallel\n");
+    printf("  cj -o|--output PREFIX   Shard file prefix (default: out)\n");
+    printf("  cj --follow|-f [file]   Stream NDJSON for records as they are appended\n");
+    printf("  cj --checkpoint FILE    Resume --follow from the byte offset saved in FILE\n");
+    printf("  cj --cache DIR [file]   Reuse JSON for unchanged parts of the input from DIR\n");
+    printf("  cj --cache-size SIZE    Cache limit, e.g. 512M (default: 1G)\n");
+    printf("  cj --head N [file]      Convert only the first N rows\n");
+    printf("  cj --sample N|P%% [file] Random sample of N rows or P percent of rows\n");
+    printf("  cj --sample-offsets     Draw --sample N rows at random file offsets (fast, approximate)\n");
+    printf("  cj --seed S             Seed for --sample (default: current time)\n");
+    printf("  cj serve --socket PATH [--threads N] [--max-request SIZE] [--timeout S]\n");
+    printf("                          Convert CSV sent over a Unix socket (default limits: 64M, 30 s)\n");
+    printf("  cj profile [--threads N] [file]\n");
+    printf("                          Print per-column statistics as JSON\n");
+    printf("  cj [options] -- file    Read file even if it is named serve, profile, version\n");
+    printf("                          or starts with '-' (./serve works too)\n");
     printf("  cj                      Show this help\n");
 }
 
@@ -30,4 +59,87 @@ int is_numeric(const char* str) {
         str++;
     }
     return 1;
-}
\ No newline at end of file
+}
+
+// Converts a value is_numeric() accepted into a native number for binary encoders
+NumberKind parse_number(const char* str, long long* int_value, double* float_value) {
+    if (!is_numeric(str)) return NUMBER_NONE;
+    
+    char* end;
+    if (!strchr(str, '.')) {
+        errno = 0;
+        long long parsed = strtoll(str, &end, 10);
+        // Integer encodings have no negative zero; "-0" falls through to -0.0
+        if (errno == 0 && end != str && *end == '\0' && !(parsed == 0 && *str == '-')) {
+            *int_value = parsed;
+            return NUMBER_INTEGER;
+        }
+    }
+    
+    // Fractions and integers beyond 64 bits; "-", "." and "+." have no value
+    double parsed = strtod(str, &end);
+    if (end == str || *end != '\0') return NUMBER_NONE;
+    *float_value = parsed;
+    return NUMBER_FLOAT;
+}
+
+int parse_output_format(const char* name, OutputFormat* format) {
+    if (strcmp(name, "json") == 0) {
+        *format = FORMAT_JSON;
+    } else if (strcmp(name, "ndjson") == 0) {
+        *format = FORMAT_NDJSON;
+    } else if (strcmp(name, "msgpack") == 0) {
+        *format = FORMAT_MSGPACK;
+    } else if (strcmp(name, "cbor") == 0) {
+        *format = FORMAT_CBOR;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int parse_invalid_utf8_policy(const char* name, InvalidUTF8Policy* policy) {
+    if (strcmp(name, "replace") == 0) {
+        *policy = INVALID_UTF8_REPLACE;
+    } else if (strcmp(name, "error") == 0) {
+        *policy = INVALID_UTF8_ERROR;
+    } else if (strcmp(name, "pass") == 0) {
+        *policy = INVALID_UTF8_PASS;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Fast non-cryptographic 64-bit hash; different seeds give independent hashes
+uint64_t hash_bytes(const char* data, size_t length, uint64_t seed) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ (uint64_t)length ^ mix64(seed);
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        h = mix64(h ^ word);
+        data += 8;
+        length -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data, length);
+    return mix64(h ^ tail ^ 0x94d049bb133111ebULL);
+}
+
+const char* output_format_extension(OutputFormat format) {
+    switch (format) {
+        case FORMAT_NDJSON: return "ndjson";
+        case FORMAT_MSGPACK: return "msgpack";
+        case FORMAT_CBOR: return "cbor";
+        default: return "json";
+    }
+}
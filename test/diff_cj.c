@@ -0,0 +1,145 @@
+// Differential correctness harness: runs every parser engine over generated
+// adversarial CSV (and any files given on the command line) and checks the
+// JSON is byte-identical to the frozen reference implementation.
+//
+// Usage: diff_cj [-n ITERATIONS] [-seed N] [file.csv ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "differential.h"
+
+#define DEFAULT_ITERATIONS 3000
+#define MAX_GENERATED_SIZE 4096
+
+#define ANSI_COLOR_RED     "\x1b[31m"
+#define ANSI_COLOR_GREEN   "\x1b[32m"
+#define ANSI_COLOR_BLUE    "\x1b[34m"
+#define ANSI_COLOR_RESET   "\x1b[0m"
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+static unsigned int next_random(void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (unsigned int)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+// Fragments that exercise the parser's quirks: both quote characters,
+// doubled quotes, whitespace trimming, CR/LF/CRLF, numbers, NUL and control
+// bytes, well-formed and ill-formed UTF-8, and runs long enough for the
+// vector escape scanner
+static const char* const fragments[] = {
+    "", "a", "abc", "1", "-2.5", "+3", ".", "1.2.3", "007", "-",
+    " ", "  ", "\t", " x ", "\"", "'", "\"\"", "''", "\"\"\"\"", "'''",
+    "\"a,b\"", "'c,d'", "\"x\"\"y\"", "'it''s'", "\"line\nbreak\"", "\"cr\rlf\"",
+    " \"padded\" ", "\"unterminated", "'open", "a\"b", "a'b", "\\", "\\\"",
+    "\xc3\xa9", "\xff\xfe", "x y z", "\x01", "\x1b[0m", "\x7f", "\b\f",
+    "\xe2\x82\xac", "\xe2\x82", "\xf0\x9f\x98\x80", "\xed\xa0\x80", "\xc0\xaf",
+    "\xf4\x90\x80\x80", "\xe0\x80\x80", "\xef\xbb\xbf",
+    "the quick brown fox jumps over the lazy dog",
+    "\xce\xb1\xce\xb2\xce\xb3\xce\xb4\xce\xb5\xce\xb6\xce\xb7\xce\xb8\xce\xb9\xce\xba",
+};
+
+static size_t append(char* buffer, size_t length, const char* text, size_t text_length) {
+    if (length + text_length > MAX_GENERATED_SIZE) return length;
+    memcpy(buffer + length, text, text_length);
+    return length + text_length;
+}
+
+static size_t generate_csv(char* buffer) {
+    static const char* const separators[] = { "\n", "\r\n", "\r", "\n\n", "\r\r\n" };
+    size_t num_fragments = sizeof(fragments) / sizeof(fragments[0]);
+    size_t length = 0;
+    int records = 1 + next_random() % 8;
+    if (next_random() % 8 == 0) length = append(buffer, length, "\xef\xbb\xbf", 3);
+    int columns = 1 + next_random() % 5;
+
+    for (int r = 0; r < records; r++) {
+        // Rows are often short or long compared to the header row
+        int fields = columns + (int)(next_random() % 3) - 1;
+        for (int f = 0; f < fields; f++) {
+            if (f > 0) length = append(buffer, length, ",", 1);
+            int pieces = next_random() % 3;
+            for (int p = 0; p < pieces; p++) {
+                unsigned int pick = next_random();
+                if (pick % 16 == 0) {
+                    char byte = (char)(next_random() % 256);
+                    length = append(buffer, length, &byte, 1);
+                } else {
+                    const char* fragment = fragments[pick % num_fragments];
+                    length = append(buffer, length, fragment, strlen(fragment));
+                }
+            }
+        }
+        if (r < records - 1 || next_random() % 2) {
+            const char* separator = separators[next_random() % 5];
+            length = append(buffer, length, separator, strlen(separator));
+        }
+    }
+    return length;
+}
+
+static int check_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot open '%s'\n", path);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* data = malloc(size > 0 ? size : 1);
+    size_t length = data ? fread(data, 1, size, file) : 0;
+    fclose(file);
+
+    int mismatches = data ? differential_check(data, length, stdout) : 1;
+    free(data);
+    return mismatches;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = DEFAULT_ITERATIONS;
+    int failures = 0;
+    int files = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            rng_state = strtoull(argv[++i], NULL, 10) | 1;
+        } else {
+            if (check_file(argv[i]) != 0) {
+                printf(ANSI_COLOR_RED "✗ FAIL" ANSI_COLOR_RESET " %s\n", argv[i]);
+                failures++;
+            }
+            files++;
+        }
+    }
+
+    printf(ANSI_COLOR_BLUE "\n=== Differential Parser Tests ===" ANSI_COLOR_RESET "\n");
+
+    static char buffer[MAX_GENERATED_SIZE];
+    for (int i = 0; i < iterations; i++) {
+        size_t length = generate_csv(buffer);
+        if (differential_check(buffer, length, stdout) != 0) {
+            FILE* dump = fopen("diff_failure.csv", "wb");
+            if (dump) {
+                fwrite(buffer, 1, length, dump);
+                fclose(dump);
+            }
+            printf(ANSI_COLOR_RED "✗ FAIL" ANSI_COLOR_RESET " generated case %d (saved to diff_failure.csv)\n", i);
+            failures++;
+            break;
+        }
+    }
+
+    if (failures == 0) {
+        printf(ANSI_COLOR_GREEN "✓ PASS" ANSI_COLOR_RESET " %d files and %d generated inputs match the reference\n",
+               files, iterations);
+    }
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,417 @@
+// Parser engines compared by the differential harness (diff_cj) and the fuzz target (fuzz_cj).
+//
+// Every engine converts the same CSV bytes to JSON; any difference from
+// reference_convert() is a bug in the engine. Register new parser paths in
+// engines[] so they are covered by `make test` and `make fuzz`.
+
+#include "cj.h"
+#include "differential.h"
+
+typedef char* (*EngineConvert)(const char* data, size_t length, int styled, size_t* out_length);
+
+typedef struct {
+    const char* name;
+    EngineConvert convert;
+    int (*accepts)(const char* data, size_t length);   // NULL: every input
+} ParserEngine;
+
+static char* render_json(CSVData* csv, int styled, size_t* out_length) {
+    OutputBuffer out;
+    if (output_init(&out, NULL) != 0) return NULL;
+    write_json_rows(&out, csv, 0, csv->num_rows, styled, 0);
+    if (out.error) {
+        output_free(&out);
+        return NULL;
+    }
+    *out_length = out.length;
+    return out.data;
+}
+
+static FILE* temp_file_with(const char* data, size_t length) {
+    FILE* file = tmpfile();
+    if (!file) return NULL;
+    if (length > 0 && fwrite(data, 1, length, file) != length) {
+        fclose(file);
+        return NULL;
+    }
+    rewind(file);
+    return file;
+}
+
+// read_csv_line() straight from a FILE*, one fgetc() at a time. The line API
+// leaves byte order marks to the caller, as read_csv() does internally.
+static char* convert_stream(const char* data, size_t length, int styled, size_t* out_length) {
+    FILE* file = temp_file_with(data, length);
+    if (!file) return NULL;
+
+    CSVData* csv = csv_create();
+    char* line = csv ? read_csv_line(file) : NULL;
+    if (line) {
+        csv_strip_bom(line);
+        int result = csv_set_headers(csv, line);
+        free(line);
+        while (result == 0 && (line = read_csv_line(file)) != NULL) {
+            if (line[0] != '\0') result = csv_append_row(csv, line);
+            free(line);
+        }
+    }
+    fclose(file);
+
+    char* json = csv ? render_json(csv, styled, out_length) : NULL;
+    free_csv(csv);
+    return json;
+}
+
+// CSVReader over a FILE*, with a tiny refill window so records, quotes and
+// CRLF pairs straddle buffer boundaries at every possible position
+static char* convert_reader_file(const char* data, size_t length, int styled, size_t* out_length) {
+    FILE* file = temp_file_with(data, length);
+    if (!file) return NULL;
+
+    CSVReader reader;
+    CSVData* csv = csv_create();
+    if (!csv || csv_reader_init_file(&reader, file) != 0) {
+        free_csv(csv);
+        fclose(file);
+        return NULL;
+    }
+    reader.storage_capacity = 1 + length % 7;
+
+    char* json = NULL;
+    if (csv_read_all(csv, &reader) == 0) {
+        json = render_json(csv, styled, out_length);
+    }
+    csv_reader_free(&reader);
+    free_csv(csv);
+    fclose(file);
+    return json;
+}
+
+// read_csv_buffer(): CSVReader over memory
+static char* convert_buffer(const char* data, size_t length, int styled, size_t* out_length) {
+    CSVData* csv = read_csv_buffer(data, length);
+    if (!csv) return NULL;
+    char* json = render_json(csv, styled, out_length);
+    free_csv(csv);
+    return json;
+}
+
+static void use_default_dialect(void) {
+    CSVDialect dialect;
+    csv_dialect_default(&dialect);
+    csv_set_dialect(&dialect);
+}
+
+// The generic kernel running the default dialect must match the comma kernel
+static char* convert_generic_kernel(const char* data, size_t length, int styled, size_t* out_length) {
+    csv_use_generic_kernel();
+    char* json = convert_buffer(data, length, styled, out_length);
+    use_default_dialect();
+    return json;
+}
+
+static void swap_bytes(char* str, size_t length, char a, char b) {
+    for (size_t i = 0; i < length; i++) {
+        if (str[i] == a) {
+            str[i] = b;
+        } else if (str[i] == b) {
+            str[i] = a;
+        }
+    }
+}
+
+// Swapping ',' with another delimiter in the input, parsing with that
+// delimiter's kernel and swapping back in the parsed values must give the
+// reference result
+static char* convert_swapped(const char* data, size_t length, int styled, size_t* out_length, char delimiter) {
+    char* swapped = malloc(length + 1);
+    if (!swapped) return NULL;
+    memcpy(swapped, data, length);
+    swap_bytes(swapped, length, ',', delimiter);
+
+    CSVDialect dialect;
+    csv_dialect_default(&dialect);
+    dialect.delimiter = delimiter;
+    csv_set_dialect(&dialect);
+    CSVData* csv = read_csv_buffer(swapped, length);
+    use_default_dialect();
+    free(swapped);
+    if (!csv) return NULL;
+
+    for (int j = 0; j < csv->num_headers; j++) {
+        swap_bytes(csv->headers[j], strlen(csv->headers[j]), ',', delimiter);
+    }
+    // The heap holds nothing but cell text
+    swap_bytes(csv->heap, csv->heap_length, ',', delimiter);
+
+    char* json = render_json(csv, styled, out_length);
+    free_csv(csv);
+    return json;
+}
+
+static char* convert_pipe_kernel(const char* data, size_t length, int styled, size_t* out_length) {
+    return convert_swapped(data, length, styled, out_length, '|');
+}
+
+static char* convert_semicolon_kernel(const char* data, size_t length, int styled, size_t* out_length) {
+    return convert_swapped(data, length, styled, out_length, ';');
+}
+
+static char* convert_tab_kernel(const char* data, size_t length, int styled, size_t* out_length) {
+    return convert_swapped(data, length, styled, out_length, '\t');
+}
+
+// The tab kernel does not trim tabs, so swapping is only exact without them
+static int has_no_tabs(const char* data, size_t length) {
+    return memchr(data, '\t', length) == NULL;
+}
+
+// Comma kernel for another quote set or trim setting
+static char* convert_comma_variant(const char* data, size_t length, int styled, size_t* out_length,
+                                   const char* quotes, int trim) {
+    CSVDialect dialect;
+    csv_dialect_default(&dialect);
+    strcpy(dialect.quotes, quotes);
+    dialect.trim = trim;
+    csv_set_dialect(&dialect);
+    char* json = convert_buffer(data, length, styled, out_length);
+    use_default_dialect();
+    return json;
+}
+
+static char* convert_dquote_kernel(const char* data, size_t length, int styled, size_t* out_length) {
+    return convert_comma_variant(data, length, styled, out_length, "\"", 1);
+}
+
+static char* convert_noquote_kernel(const char* data, size_t length, int styled, size_t* out_length) {
+    return convert_comma_variant(data, length, styled, out_length, "", 1);
+}
+
+static char* convert_notrim_kernel(const char* data, size_t length, int styled, size_t* out_length) {
+    return convert_comma_variant(data, length, styled, out_length, "\"'", 0);
+}
+
+// Each variant agrees with the default dialect on inputs without the bytes it treats differently
+static int has_no_single_quotes(const char* data, size_t length) {
+    return memchr(data, '\'', length) == NULL;
+}
+
+static int has_no_quotes(const char* data, size_t length) {
+    return has_no_single_quotes(data, length) && memchr(data, '"', length) == NULL;
+}
+
+static int has_no_blanks(const char* data, size_t length) {
+    return has_no_tabs(data, length) && memchr(data, ' ', length) == NULL;
+}
+
+// Skips a UTF-8 byte order mark the way the block readers of profile and
+// cache mode do, before any record is looked at
+static size_t bom_length(const char* data, size_t length) {
+    return length >= 3 && memcmp(data, UTF8_BOM, 3) == 0 ? 3 : 0;
+}
+
+// Appends the records of data[0..length) to csv, which already has headers
+static int append_records(CSVData* csv, const char* data, size_t length) {
+    CSVReader reader;
+    csv_reader_init_buffer(&reader, data, length);
+    return csv_read_all(csv, &reader);
+}
+
+// profile_split_records(): the header comes first, then the rest is cut into
+// three chunks plus the incomplete tail, each parsed on its own. A cut
+// inside a record changes the rows.
+static char* convert_profile_split(const char* data, size_t length, int styled, size_t* out_length) {
+    unsigned char is_quote[256] = { 0 };
+    for (const char* q = csv_get_dialect()->quotes; *q; q++) is_quote[(unsigned char)*q] = 1;
+
+    size_t start = bom_length(data, length);
+    CSVData* csv = csv_create();
+    long long consumed = csv ? csv_read_headers(csv, data + start, length - start) : -1;
+    int result = consumed < 0 ? -1 : 0;
+    if (result == 0 && csv->headers) {
+        start += (size_t)consumed;
+        size_t bounds[4];
+        size_t complete = start + profile_split_records(data + start, length - start, is_quote, 0, bounds, 3);
+        for (int k = 0; k < 3 && result == 0; k++) {
+            result = append_records(csv, data + start + bounds[k], bounds[k + 1] - bounds[k]);
+        }
+        if (result == 0 && start + bounds[3] != complete) result = -1;
+        if (result == 0) result = append_records(csv, data + complete, length - complete);
+    }
+
+    char* json = result == 0 ? render_json(csv, styled, out_length) : NULL;
+    free_csv(csv);
+    return json;
+}
+
+// cache_chunker_next() with tiny chunks, refilled a few bytes at a time the
+// way convert_chunks() reads blocks; each chunk is parsed on its own, the
+// first one also supplying the header. A cut inside a record changes the rows.
+static char* convert_cache_chunks(const char* data, size_t length, int styled, size_t* out_length) {
+    CacheChunker chunker;
+    cache_chunker_init(&chunker, 1, 48, 3);
+
+    CSVData* csv = csv_create();
+    int result = csv ? 0 : -1;
+    size_t start = bom_length(data, length);
+    size_t available = start;
+    int at_eof = available == length;
+    while (result == 0) {
+        size_t chunk = cache_chunker_next(&chunker, data + start, available - start, at_eof);
+        if (chunk > 0) {
+            const char* records = data + start;
+            size_t records_length = chunk;
+            start += chunk;
+            if (!csv->headers) {
+                long long consumed = csv_read_headers(csv, records, records_length);
+                if (consumed < 0) {
+                    result = -1;
+                    break;
+                }
+                records += consumed;
+                records_length -= (size_t)consumed;
+                if (!csv->headers) continue;
+            }
+            result = append_records(csv, records, records_length);
+            continue;
+        }
+        if (at_eof) break;
+        available += 1 + available % 5;
+        if (available >= length) {
+            available = length;
+            at_eof = 1;
+        }
+    }
+
+    char* json = result == 0 ? render_json(csv, styled, out_length) : NULL;
+    free_csv(csv);
+    return json;
+}
+
+// Walks the records from offset through a tiny refill window, passing over
+// every other one with csv_reader_skip() (even indexes when parity is 0, odd
+// ones when it is 1) and storing the rest in lines[] by index. Returns the
+// record count, or -1 on error or past capacity records.
+static long long skip_alternating(FILE* file, long long offset, size_t window, int parity,
+                                  char** lines, long long capacity) {
+    CSVReader reader;
+    if (csv_reader_init_file(&reader, file) != 0) return -1;
+    reader.storage_capacity = window;
+
+    long long count = csv_reader_seek(&reader, offset) == 0 ? 0 : -1;
+    while (count >= 0 && count <= capacity) {
+        if (count % 2 == parity) {
+            int result = csv_reader_skip(&reader);
+            if (result < 0) break;
+            count += result;
+            continue;
+        }
+        char* line = csv_reader_next(&reader, NULL);
+        if (!line) break;
+        if (line[0] == '\0') {
+            free(line);
+            continue;
+        }
+        lines[count++] = line;
+    }
+    csv_reader_free(&reader);
+    return count <= capacity ? count : -1;
+}
+
+// csv_reader_skip() interleaved with csv_reader_next(), as sample mode reads:
+// two passes keep the odd and then the even records, and must agree on the
+// record count. A skip that stops at the wrong boundary or disagrees about
+// which records are empty changes the rows.
+static char* convert_skip_alternating(const char* data, size_t length, int styled, size_t* out_length) {
+    FILE* file = temp_file_with(data, length);
+    if (!file) return NULL;
+
+    long long capacity = (long long)length;
+    char** lines = calloc((size_t)capacity + 1, sizeof(char*));
+    size_t start = bom_length(data, length);
+    CSVData* csv = lines ? csv_create() : NULL;
+    long long consumed = csv ? csv_read_headers(csv, data + start, length - start) : -1;
+    int result = consumed < 0 ? -1 : 0;
+    if (result == 0 && csv->headers) {
+        long long offset = (long long)start + consumed;
+        size_t window = 1 + length % 7;
+        long long count = skip_alternating(file, offset, window, 0, lines, capacity);
+        if (count < 0 || skip_alternating(file, offset, window, 1, lines, capacity) != count) {
+            result = -1;
+        }
+        for (long long i = 0; result == 0 && i < count; i++) {
+            result = lines[i] ? csv_append_row(csv, lines[i]) : -1;
+        }
+    }
+
+    char* json = result == 0 ? render_json(csv, styled, out_length) : NULL;
+    for (long long i = 0; lines && i <= capacity; i++) free(lines[i]);
+    free(lines);
+    free_csv(csv);
+    fclose(file);
+    return json;
+}
+
+static const ParserEngine engines[] = {
+    { "stream", convert_stream, NULL },
+    { "reader-file", convert_reader_file, NULL },
+    { "buffer", convert_buffer, NULL },
+    { "kernel-generic", convert_generic_kernel, NULL },
+    { "kernel-pipe", convert_pipe_kernel, NULL },
+    { "kernel-semicolon", convert_semicolon_kernel, NULL },
+    { "kernel-tab", convert_tab_kernel, has_no_tabs },
+    { "kernel-dquote", convert_dquote_kernel, has_no_single_quotes },
+    { "kernel-noquote", convert_noquote_kernel, has_no_quotes },
+    { "kernel-notrim", convert_notrim_kernel, has_no_blanks },
+    { "profile-split", convert_profile_split, NULL },
+    { "cache-chunks", convert_cache_chunks, NULL },
+    { "skip-alternating", convert_skip_alternating, NULL },
+};
+
+static void report_mismatch(FILE* report, const char* engine, int styled,
+                            const char* expected, size_t expected_length,
+                            const char* actual, size_t actual_length) {
+    if (!report) return;
+
+    size_t offset = 0;
+    while (offset < expected_length && offset < actual_length && expected[offset] == actual[offset]) {
+        offset++;
+    }
+    size_t start = offset > 20 ? offset - 20 : 0;
+    int expected_tail = (int)((expected_length - start) < 40 ? expected_length - start : 40);
+    int actual_tail = (int)((actual_length - start) < 40 ? actual_length - start : 40);
+
+    fprintf(report, "engine '%s' (%s) differs at byte %lu\n", engine, styled ? "styled" : "compact",
+            (unsigned long)offset);
+    fprintf(report, "  reference: ...%.*s\n", expected_tail, expected + start);
+    fprintf(report, "  engine:    ...%.*s\n", actual_tail, actual + start);
+}
+
+int differential_check(const char* data, size_t length, FILE* report) {
+    int mismatches = 0;
+
+    for (int styled = 0; styled <= 1; styled++) {
+        size_t expected_length = 0;
+        char* expected = reference_convert(data, length, styled, &expected_length);
+        if (!expected) continue;
+
+        for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+            if (engines[i].accepts && !engines[i].accepts(data, length)) continue;
+            size_t actual_length = 0;
+            char* actual = engines[i].convert(data, length, styled, &actual_length);
+            if (!actual) {
+                if (report) fprintf(report, "engine '%s' failed to convert input\n", engines[i].name);
+                mismatches++;
+                continue;
+            }
+            if (actual_length != expected_length || memcmp(actual, expected, expected_length) != 0) {
+                report_mismatch(report, engines[i].name, styled, expected, expected_length, actual, actual_length);
+                mismatches++;
+            }
+            free(actual);
+        }
+        free(expected);
+    }
+
+    return mismatches;
+}
@@ -0,0 +1,16 @@
+#ifndef DIFFERENTIAL_H
+#define DIFFERENTIAL_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Frozen reference conversion (test/reference_cj.c). Returns the JSON document
+// print_json() produced for this input before any parser optimizations, with
+// the current escaping rules (controls as \u00XX, ill-formed UTF-8 as U+FFFD).
+char* reference_convert(const char* data, size_t length, int styled, size_t* out_length);
+
+// Runs every parser engine over the input and compares its JSON byte for byte
+// with the reference. Returns the number of mismatches; details go to report.
+int differential_check(const char* data, size_t length, FILE* report);
+
+#endif // DIFFERENTIAL_H
@@ -0,0 +1,59 @@
+// Fuzz target for the CSV parser engines.
+//
+// libFuzzer:  make fuzz && ./test/fuzz_cj -max_len=4096 corpus/
+// AFL:        afl-clang-fast -Isrc test/fuzz_cj.c test/differential.c test/reference_cj.c <src objects>
+//             afl-fuzz -i test -o findings -- ./fuzz_cj @@
+//
+// Each input goes through every engine in differential.c; a mismatch with
+// the reference implementation aborts so the fuzzer records the input.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "differential.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (differential_check((const char*)data, size, stderr) != 0) {
+        abort();
+    }
+    return 0;
+}
+
+#ifndef CJ_LIBFUZZER
+// Standalone driver for AFL and for replaying crash files: reads each file
+// argument (or stdin) and runs it through the target
+static int run_file(FILE* file) {
+    size_t capacity = 4096;
+    size_t length = 0;
+    uint8_t* data = malloc(capacity);
+    size_t n;
+    while (data && (n = fread(data + length, 1, capacity - length, file)) > 0) {
+        length += n;
+        if (length == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+    if (!data) return 1;
+    LLVMFuzzerTestOneInput(data, length);
+    free(data);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) return run_file(stdin);
+
+    for (int i = 1; i < argc; i++) {
+        FILE* file = fopen(argv[i], "rb");
+        if (!file) {
+            fprintf(stderr, "Cannot open '%s'\n", argv[i]);
+            return 1;
+        }
+        run_file(file);
+        fclose(file);
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,504 @@
+// Frozen reference implementation of the CSV to JSON conversion.
+//
+// This is the original read_csv_line()/parse_csv_line()/print_json() code,
+// reading from memory instead of a FILE* and printing into a string. The
+// differential harness compares every optimized parser engine against it, so
+// only change it when the intended output format itself changes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include "differential.h"
+
+#define INITIAL_CAPACITY 16
+#define INITIAL_LINE_SIZE 256
+
+typedef struct {
+    char** headers;
+    char*** data;
+    int num_headers;
+    int num_rows;
+    int headers_capacity;
+    int rows_capacity;
+    int* field_capacities;
+} RefCSV;
+
+// fgetc()/ungetc() over a memory buffer
+typedef struct {
+    const char* data;
+    size_t length;
+    size_t pos;
+} MemFile;
+
+static int mem_getc(MemFile* file) {
+    if (file->pos >= file->length) return EOF;
+    return (unsigned char)file->data[file->pos++];
+}
+
+static void mem_ungetc(MemFile* file) {
+    file->pos--;
+}
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} StringBuilder;
+
+static void sb_printf(StringBuilder* sb, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    
+    if (needed > 0) {
+        while (sb->length + (size_t)needed + 1 > sb->capacity) {
+            sb->capacity = sb->capacity ? sb->capacity * 2 : 256;
+            sb->data = realloc(sb->data, sb->capacity);
+            if (!sb->data) abort();
+        }
+        vsnprintf(sb->data + sb->length, needed + 1, format, args);
+        sb->length += needed;
+    }
+    va_end(args);
+}
+
+static int ref_is_numeric(const char* str) {
+    if (*str == '\0') return 0;
+    if (*str == '-' || *str == '+') str++;
+    int has_dot = 0;
+    while (*str) {
+        if (*str == '.') {
+            if (has_dot) return 0;
+            has_dot = 1;
+        } else if (!isdigit(*str)) {
+            return 0;
+        }
+        str++;
+    }
+    return 1;
+}
+
+static char* ref_read_csv_line(MemFile* file) {
+    size_t capacity = INITIAL_LINE_SIZE;
+    char* line = malloc(capacity);
+    if (!line) return NULL;
+    
+    size_t length = 0;
+    int c;
+    int in_quotes = 0;
+    char quote_char = 0;
+    
+    while ((c = mem_getc(file)) != EOF) {
+        if (length + 2 >= capacity) {
+            capacity *= 2;
+            char* new_line = realloc(line, capacity);
+            if (!new_line) {
+                free(line);
+                return NULL;
+            }
+            line = new_line;
+        }
+        
+        if (!in_quotes && (c == '"' || c == '\'')) {
+            in_quotes = 1;
+            quote_char = c;
+            line[length++] = c;
+        } else if (in_quotes && c == quote_char) {
+            int next_c = mem_getc(file);
+            if (next_c == quote_char) {
+                line[length++] = c;
+                line[length++] = next_c;
+            } else {
+                line[length++] = c;
+                in_quotes = 0;
+                if (next_c != EOF) {
+                    mem_ungetc(file);
+                }
+            }
+        } else if (!in_quotes && (c == '\n' || c == '\r')) {
+            if (c == '\r') {
+                int next_c = mem_getc(file);
+                if (next_c != '\n' && next_c != EOF) {
+                    mem_ungetc(file);
+                }
+            }
+            break;
+        } else {
+            line[length++] = c;
+        }
+    }
+    
+    if (length == 0 && c == EOF) {
+        free(line);
+        return NULL;
+    }
+    
+    line[length] = '\0';
+    return line;
+}
+
+static char** ref_parse_csv_line(char* line, int* field_count) {
+    size_t capacity = INITIAL_CAPACITY;
+    char** fields = malloc(capacity * sizeof(char*));
+    if (!fields) return NULL;
+    
+    *field_count = 0;
+    char* ptr = line;
+    
+    while (*ptr) {
+        if ((size_t)*field_count >= capacity) {
+            capacity *= 2;
+            char** new_fields = realloc(fields, capacity * sizeof(char*));
+            if (!new_fields) {
+                for (int i = 0; i < *field_count; i++) {
+                    free(fields[i]);
+                }
+                free(fields);
+                return NULL;
+            }
+            fields = new_fields;
+        }
+        
+        while (*ptr == ' ' || *ptr == '\t') ptr++;
+        
+        size_t field_capacity = INITIAL_LINE_SIZE;
+        char* field = malloc(field_capacity);
+        if (!field) {
+            for (int i = 0; i < *field_count; i++) {
+                free(fields[i]);
+            }
+            free(fields);
+            return NULL;
+        }
+        
+        size_t field_length = 0;
+        int in_quotes = 0;
+        char quote_char = 0;
+        
+        if (*ptr == '"' || *ptr == '\'') {
+            quote_char = *ptr;
+            in_quotes = 1;
+            ptr++;
+        }
+        
+        while (*ptr && (in_quotes || *ptr != ',')) {
+            if (in_quotes && *ptr == quote_char) {
+                if (*(ptr + 1) == quote_char) {
+                    if (field_length >= field_capacity - 1) {
+                        field_capacity *= 2;
+                        char* new_field = realloc(field, field_capacity);
+                        if (!new_field) {
+                            free(field);
+                            for (int i = 0; i < *field_count; i++) {
+                                free(fields[i]);
+                            }
+                            free(fields);
+                            return NULL;
+                        }
+                        field = new_field;
+                    }
+                    field[field_length++] = *ptr;
+                    ptr += 2;
+                } else {
+                    in_quotes = 0;
+                    ptr++;
+                    continue;
+                }
+            } else {
+                if (field_length >= field_capacity - 1) {
+                    field_capacity *= 2;
+                    char* new_field = realloc(field, field_capacity);
+                    if (!new_field) {
+                        free(field);
+                        for (int i = 0; i < *field_count; i++) {
+                            free(fields[i]);
+                        }
+                        free(fields);
+                        return NULL;
+                    }
+                    field = new_field;
+                }
+                
+                field[field_length++] = *ptr;
+                ptr++;
+            }
+        }
+        
+        field[field_length] = '\0';
+        
+        char* trimmed_field = field;
+        while (*trimmed_field == ' ' || *trimmed_field == '\t') trimmed_field++;
+        char* end = trimmed_field + strlen(trimmed_field) - 1;
+        while (end >= trimmed_field && (*end == ' ' || *end == '\t')) {
+            *end = '\0';
+            end--;
+        }
+        
+        fields[*field_count] = malloc(strlen(trimmed_field) + 1);
+        if (!fields[*field_count]) {
+            free(field);
+            for (int i = 0; i < *field_count; i++) {
+                free(fields[i]);
+            }
+            free(fields);
+            return NULL;
+        }
+        strcpy(fields[*field_count], trimmed_field);
+        free(field);
+        
+        (*field_count)++;
+        
+        if (*ptr == ',') ptr++;
+    }
+    
+    return fields;
+}
+
+static RefCSV* ref_read_csv(const char* data, size_t length) {
+    MemFile mem = { data, length, 0 };
+    MemFile* file = &mem;
+    
+    RefCSV* csv = malloc(sizeof(RefCSV));
+    if (!csv) {
+        return NULL;
+    }
+    
+    csv->headers = NULL;
+    csv->data = NULL;
+    csv->num_headers = 0;
+    csv->num_rows = 0;
+    csv->headers_capacity = 0;
+    csv->rows_capacity = INITIAL_CAPACITY;
+    csv->field_capacities = NULL;
+    
+    char* line = ref_read_csv_line(file);
+    if (line) {
+        csv->headers = ref_parse_csv_line(line, &csv->num_headers);
+        csv->headers_capacity = csv->num_headers;
+        free(line);
+        
+        if (!csv->headers) {
+            free(csv);
+                return NULL;
+        }
+    }
+    
+    csv->data = malloc(csv->rows_capacity * sizeof(char**));
+    csv->field_capacities = malloc(csv->rows_capacity * sizeof(int));
+    if (!csv->data || !csv->field_capacities) {
+        if (csv->headers) {
+            for (int i = 0; i < csv->num_headers; i++) {
+                free(csv->headers[i]);
+            }
+            free(csv->headers);
+        }
+        free(csv->data);
+        free(csv->field_capacities);
+        free(csv);
+        return NULL;
+    }
+    
+    while ((line = ref_read_csv_line(file)) != NULL) {
+        if (strlen(line) == 0) {
+            free(line);
+            continue;
+        }
+        
+        if (csv->num_rows >= csv->rows_capacity) {
+            csv->rows_capacity *= 2;
+            char*** new_data = realloc(csv->data, csv->rows_capacity * sizeof(char**));
+            int* new_capacities = realloc(csv->field_capacities, csv->rows_capacity * sizeof(int));
+            if (!new_data || !new_capacities) {
+                free(line);
+                break;
+            }
+            csv->data = new_data;
+            csv->field_capacities = new_capacities;
+        }
+        
+        int field_count;
+        csv->data[csv->num_rows] = ref_parse_csv_line(line, &field_count);
+        csv->field_capacities[csv->num_rows] = field_count;
+        
+        if (!csv->data[csv->num_rows]) {
+            free(line);
+            break;
+        }
+        
+        csv->num_rows++;
+        free(line);
+    }
+    
+    return csv;
+}
+
+static void ref_free_csv(RefCSV* csv) {
+    if (!csv) return;
+    
+    if (csv->headers) {
+        for (int i = 0; i < csv->num_headers; i++) {
+            free(csv->headers[i]);
+        }
+        free(csv->headers);
+    }
+    
+    if (csv->data) {
+        for (int i = 0; i < csv->num_rows; i++) {
+            if (csv->data[i]) {
+                for (int j = 0; j < csv->field_capacities[i]; j++) {
+                    free(csv->data[i][j]);
+                }
+                free(csv->data[i]);
+            }
+        }
+        free(csv->data);
+    }
+    
+    free(csv->field_capacities);
+    free(csv);
+}
+
+// Length of the non-ASCII character at s, or of the maximal subpart of an
+// ill-formed sequence with *well_formed cleared (Unicode 3.9, "U+FFFD substitution")
+static size_t ref_utf8_sequence(const unsigned char* s, int* well_formed) {
+    int expected;
+    unsigned int min;
+    unsigned int code;
+    *well_formed = 0;
+    if ((s[0] & 0xe0) == 0xc0) {
+        expected = 2; min = 0x80; code = s[0] & 0x1f;
+    } else if ((s[0] & 0xf0) == 0xe0) {
+        expected = 3; min = 0x800; code = s[0] & 0x0f;
+    } else if ((s[0] & 0xf8) == 0xf0) {
+        expected = 4; min = 0x10000; code = s[0] & 0x07;
+    } else {
+        return 1;
+    }
+
+    for (int k = 1; k < expected; k++) {
+        if ((s[k] & 0xc0) != 0x80) return (size_t)k;
+        code = (code << 6) | (s[k] & 0x3f);
+        // Stop as soon as no continuation could make the prefix well-formed
+        int remaining = expected - 1 - k;
+        unsigned int lowest = code << (6 * remaining);
+        unsigned int highest = lowest | ((1u << (6 * remaining)) - 1);
+        if (highest < min || lowest > 0x10ffff ||
+            (lowest >= 0xd800 && highest <= 0xdfff)) {
+            return (size_t)k;
+        }
+    }
+    *well_formed = 1;
+    return (size_t)expected;
+}
+
+static void ref_print_json_string(StringBuilder* sb, const char* value) {
+    sb_printf(sb, "\"");
+    const unsigned char* p = (const unsigned char*)value;
+    while (*p) {
+        if (*p >= 0x80) {
+            int well_formed;
+            size_t n = ref_utf8_sequence(p, &well_formed);
+            if (well_formed) {
+                sb_printf(sb, "%.*s", (int)n, (const char*)p);
+            } else {
+                sb_printf(sb, "\xEF\xBF\xBD");
+            }
+            p += n;
+        } else if (*p == '"') {
+            sb_printf(sb, "\\\"");
+            p++;
+        } else if (*p == '\\') {
+            sb_printf(sb, "\\\\");
+            p++;
+        } else if (*p == '\n') {
+            sb_printf(sb, "\\n");
+            p++;
+        } else if (*p == '\r') {
+            sb_printf(sb, "\\r");
+            p++;
+        } else if (*p == '\t') {
+            sb_printf(sb, "\\t");
+            p++;
+        } else if (*p < 0x20) {
+            sb_printf(sb, "\\u%04x", *p);
+            p++;
+        } else {
+            sb_printf(sb, "%c", *p);
+            p++;
+        }
+    }
+    sb_printf(sb, "\"");
+}
+
+static void ref_print_json_value(StringBuilder* sb, const char* value) {
+    if (strlen(value) == 0) {
+        sb_printf(sb, "\"\"");
+    } else if (ref_is_numeric(value)) {
+        sb_printf(sb, "%s", value);
+    } else {
+        ref_print_json_string(sb, value);
+    }
+}
+
+static void ref_print_json(StringBuilder* sb, RefCSV* csv, int styled) {
+    sb_printf(sb, "[");
+    if (styled) sb_printf(sb, "\n");
+    
+    for (int i = 0; i < csv->num_rows; i++) {
+        if (styled) sb_printf(sb, "  ");
+        sb_printf(sb, "{");
+        if (styled) sb_printf(sb, "\n");
+        
+        int max_fields = csv->field_capacities[i] < csv->num_headers ? 
+                        csv->field_capacities[i] : csv->num_headers;
+        
+        for (int j = 0; j < csv->num_headers; j++) {
+            if (styled) sb_printf(sb, "    ");
+            ref_print_json_string(sb, csv->headers[j]);
+            sb_printf(sb, ": ");
+            
+            if (j < max_fields) {
+                ref_print_json_value(sb, csv->data[i][j]);
+            } else {
+                sb_printf(sb, "\"\"");
+            }
+            
+            if (j < csv->num_headers - 1) {
+                sb_printf(sb, ",");
+            }
+            if (styled) sb_printf(sb, "\n");
+        }
+        
+        if (styled) sb_printf(sb, "  ");
+        sb_printf(sb, "}");
+        
+        if (i < csv->num_rows - 1) {
+            sb_printf(sb, ",");
+        }
+        if (styled) sb_printf(sb, "\n");
+    }
+    
+    sb_printf(sb, "]");
+    if (styled) sb_printf(sb, "\n");
+}
+
+char* reference_convert(const char* data, size_t length, int styled, size_t* out_length) {
+    if (length >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        data += 3;
+        length -= 3;
+    }
+    RefCSV* csv = ref_read_csv(data, length);
+    if (!csv) return NULL;
+    
+    StringBuilder sb = { NULL, 0, 0 };
+    ref_print_json(&sb, csv, styled);
+    ref_free_csv(csv);
+    
+    *out_length = sb.length;
+    return sb.data;
+}
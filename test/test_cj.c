@@ -11,6 +11,10 @@
 #define pclose _pclose
 #else
 #include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #endif
 
@@ -78,6 +82,38 @@ char* run_command(const char* command) {
     return output;
 }
 
+char* read_file_length(const char* path, size_t* length) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    
+    char* content = malloc(size + 1);
+    if (!content) {
+        fclose(fp);
+        return NULL;
+    }
+    *length = fread(content, 1, size, fp);
+    content[*length] = '\0';
+    fclose(fp);
+    return content;
+}
+
+char* read_file(const char* path) {
+    size_t length;
+    return read_file_length(path, &length);
+}
+
+void append_file(const char* path, const char* mode, const char* content) {
+    FILE* fp = fopen(path, mode);
+    if (fp) {
+        fputs(content, fp);
+        fclose(fp);
+    }
+}
+
 char* run_cj_command(const char* args) {
     char cmd[1024];
     char args_copy[1024];
@@ -237,6 +273,24 @@ void test_usage_output() {
     }
 }
 
+void test_command_named_files() {
+    // Files named like a command are reachable after -- or through a path
+    append_file("serve", "wb", "name\nfile\n");
+    append_file("-dash.csv", "wb", "name\ndash\n");
+    char* output = run_cj_command("-- serve 2>&1");
+    char* dotted = run_cj_command("./serve 2>&1");
+    test_assert(output && dotted && strcmp(output, "[{\"name\": \"file\"}]\n") == 0 && strcmp(dotted, output) == 0,
+                "-- and ./ name a file called serve");
+    free(output);
+    free(dotted);
+    
+    output = run_cj_command("--ndjson -- -dash.csv 2>&1");
+    test_assert(output && strcmp(output, "{\"name\": \"dash\"}\n") == 0, "-- allows a file name starting with -");
+    free(output);
+    remove("serve");
+    remove("-dash.csv");
+}
+
 void test_error_handling() {
     printf(ANSI_COLOR_BLUE "\n=== Error Handling Tests ===" ANSI_COLOR_RESET "\n");
     
@@ -307,6 +361,579 @@ void test_edge_cases() {
     } else {
         test_assert(0, "Edge cases test");
     }
+    
+    // Short rows are padded with "" and extra fields dropped, also when the first row sets the width
+    append_file("ragged_test.csv", "wb", "a,b\n1\n2,3,4\n");
+    output = run_cj_command("--ndjson ragged_test.csv 2>/dev/null");
+    test_assert(output && strcmp(output, "{\"a\": 1,\"b\": \"\"}\n{\"a\": 2,\"b\": 3}\n") == 0,
+                "Ragged rows fit the header");
+    free(output);
+    output = run_cj_command("--ndjson --no-header ragged_test.csv 2>/dev/null");
+    test_assert(output && strcmp(output, "{\"1\": \"a\",\"2\": \"b\"}\n{\"1\": 1,\"2\": \"\"}\n"
+                                         "{\"1\": 2,\"2\": 3}\n") == 0,
+                "Ragged rows fit the first row without a header");
+    free(output);
+    remove("ragged_test.csv");
+}
+
+void test_ndjson_output() {
+    printf(ANSI_COLOR_BLUE "\n=== NDJSON Output Tests ===" ANSI_COLOR_RESET "\n");
+    
+    char* output = run_cj_command("--ndjson numeric.csv 2>/dev/null");
+    if (output) {
+        test_assert(strncmp(output, "{\"integer\": 42,", 15) == 0, "NDJSON record starts line");
+        test_assert(strstr(output, "}\n{\"integer\": 100,") != NULL, "One record per line");
+        test_assert(output[0] != '[', "NDJSON has no enclosing array");
+        free(output);
+    } else {
+        test_assert(0, "NDJSON output test");
+    }
+}
+
+void test_binary_formats() {
+    printf(ANSI_COLOR_BLUE "\n=== Binary Format Tests ===" ANSI_COLOR_RESET "\n");
+    
+    // [{"integer": 42, "float": 3.14, "negative": -10, ...}, ...] with three rows
+    static const unsigned char msgpack_prefix[] = {
+        0x93, 0x85, 0xa7, 'i', 'n', 't', 'e', 'g', 'e', 'r', 0x2a,
+        0xa5, 'f', 'l', 'o', 'a', 't', 0xcb, 0x40, 0x09, 0x1e, 0xb8, 0x51, 0xeb, 0x85, 0x1f,
+        0xa8, 'n', 'e', 'g', 'a', 't', 'i', 'v', 'e', 0xf6,
+        0xa4, 't', 'e', 'x', 't', 0xa6, 'a', 'b', 'c', '1', '2', '3'
+    };
+    static const unsigned char cbor_prefix[] = {
+        0x83, 0xa5, 0x67, 'i', 'n', 't', 'e', 'g', 'e', 'r', 0x18, 0x2a,
+        0x65, 'f', 'l', 'o', 'a', 't', 0xfb, 0x40, 0x09, 0x1e, 0xb8, 0x51, 0xeb, 0x85, 0x1f,
+        0x68, 'n', 'e', 'g', 'a', 't', 'i', 'v', 'e', 0x29,
+        0x64, 't', 'e', 'x', 't', 0x66, 'a', 'b', 'c', '1', '2', '3'
+    };
+    
+    size_t length = 0;
+    char* output = run_cj_command("--format msgpack numeric.csv > bin_test.msgpack 2>/dev/null");
+    free(output);
+    char* msgpack = read_file_length("bin_test.msgpack", &length);
+    test_assert(msgpack && length > sizeof(msgpack_prefix) &&
+                memcmp(msgpack, msgpack_prefix, sizeof(msgpack_prefix)) == 0,
+                "MessagePack uses native integers and floats");
+    free(msgpack);
+    
+    output = run_cj_command("--format cbor numeric.csv > bin_test.cbor 2>/dev/null");
+    free(output);
+    char* cbor = read_file_length("bin_test.cbor", &length);
+    test_assert(cbor && length > sizeof(cbor_prefix) &&
+                memcmp(cbor, cbor_prefix, sizeof(cbor_prefix)) == 0,
+                "CBOR uses native integers and floats");
+    free(cbor);
+    
+    output = run_cj_command("--format cbor --shards 2 -o bin_test numeric.csv 2>&1");
+    free(output);
+    char* shard = read_file_length("bin_test.0001.cbor", &length);
+    test_assert(shard && length > 2 && (unsigned char)shard[0] == 0x81 && (unsigned char)shard[1] == 0xa5,
+                "Binary shards are standalone documents");
+    free(shard);
+    
+    // [{"z": -0.0}]: the sign survives, as it does in JSON output
+    static const unsigned char negative_zero[] = {
+        0x91, 0x81, 0xa1, 'z', 0xcb, 0x80, 0, 0, 0, 0, 0, 0, 0
+    };
+    append_file("bin_test.csv", "wb", "z\n-0\n");
+    output = run_cj_command("--format msgpack bin_test.csv > bin_test.msgpack 2>/dev/null");
+    free(output);
+    msgpack = read_file_length("bin_test.msgpack", &length);
+    test_assert(msgpack && length == sizeof(negative_zero) && memcmp(msgpack, negative_zero, length) == 0,
+                "Negative zero keeps its sign");
+    free(msgpack);
+    remove("bin_test.csv");
+    
+    output = run_cj_command("--format yaml numeric.csv 2>&1");
+    test_assert(output && strstr(output, "Usage:") != NULL, "Unknown format rejected");
+    free(output);
+    
+    remove("bin_test.msgpack");
+    remove("bin_test.cbor");
+    remove("bin_test.0000.cbor");
+    remove("bin_test.0001.cbor");
+}
+
+#ifdef __linux__
+// Reads a command's output like a reader that moves pipe pages with splice()
+// and only looks at them later, which is how a stage such as `pv` or a proxy
+// can see them. Pages the writer changes after vmsplice() show up here.
+static char* read_spliced(const char* command, size_t* length) {
+    FILE* fp = popen(command, "r");
+    if (!fp) return NULL;
+    int held[2];
+    if (pipe(held) != 0) {
+        pclose(fp);
+        return NULL;
+    }
+    fcntl(held[1], F_SETPIPE_SZ, 1024 * 1024);
+
+    size_t capacity = 1024 * 1024;
+    char* output = malloc(capacity);
+    *length = 0;
+    for (;;) {
+        ssize_t moved = splice(fileno(fp), NULL, held[1], NULL, 1024 * 1024, SPLICE_F_MOVE);
+        if (moved <= 0) break;
+        usleep(50000);
+        while (output && moved > 0) {
+            if (*length + (size_t)moved > capacity) {
+                capacity *= 2;
+                char* grown = realloc(output, capacity);
+                if (!grown) {
+                    free(output);
+                    output = NULL;
+                    break;
+                }
+                output = grown;
+            }
+            ssize_t n = read(held[0], output + *length, (size_t)moved);
+            if (n <= 0) break;
+            *length += (size_t)n;
+            moved -= n;
+        }
+    }
+    close(held[0]);
+    close(held[1]);
+    pclose(fp);
+    return output;
+}
+#endif
+
+void test_async_output() {
+    printf(ANSI_COLOR_BLUE "\n=== Async Output Tests ===" ANSI_COLOR_RESET "\n");
+    
+#ifdef _WIN32
+    test_assert(1, "Async output (skipped on Windows)");
+#else
+    // Several megabytes of JSON so both halves of the double buffer are reused
+    FILE* fp = fopen("async_test.csv", "wb");
+    if (fp) {
+        fprintf(fp, "id,name,note\n");
+        for (int i = 0; i < 100000; i++) {
+            fprintf(fp, "%d,user_%d,\"line %d, \"\"quoted\"\"\"\n", i, i % 977, i);
+        }
+        fclose(fp);
+    }
+    
+    char* output = run_cj_command("async_test.csv > async_stdio.out 2>/dev/null");
+    free(output);
+    output = run_cj_command("--io async async_test.csv 2>/dev/null | cat > async_pipe.out");
+    free(output);
+    output = run_cj_command("--io async async_test.csv > async_file.out 2>/dev/null");
+    free(output);
+    
+    size_t expected_length = 0, pipe_length = 0, file_length = 0;
+    char* expected = read_file_length("async_stdio.out", &expected_length);
+    char* piped = read_file_length("async_pipe.out", &pipe_length);
+    char* filed = read_file_length("async_file.out", &file_length);
+    test_assert(expected && expected_length > 4 * 1024 * 1024, "Async test output spans several buffers");
+    test_assert(expected && piped && pipe_length == expected_length &&
+                memcmp(piped, expected, expected_length) == 0, "Async pipe output matches stdio");
+    test_assert(expected && filed && file_length == expected_length &&
+                memcmp(filed, expected, expected_length) == 0, "Async file output matches stdio");
+    free(piped);
+    free(filed);
+    
+#ifdef __linux__
+    size_t spliced_length = 0;
+    char* spliced = read_spliced("../cj --io async async_test.csv 2>/dev/null", &spliced_length);
+    test_assert(expected && spliced && spliced_length == expected_length &&
+                memcmp(spliced, expected, expected_length) == 0,
+                "Async pipe output survives a reader that splices pages away");
+    free(spliced);
+#else
+    test_assert(1, "Async splice reader (Linux only)");
+#endif
+    free(expected);
+    
+    remove("async_test.csv");
+    remove("async_stdio.out");
+    remove("async_pipe.out");
+    remove("async_file.out");
+#endif
+}
+
+void test_sharded_output() {
+    printf(ANSI_COLOR_BLUE "\n=== Sharded Output Tests ===" ANSI_COLOR_RESET "\n");
+    
+    char* output = run_cj_command("--shards 2 -o shard_test numeric.csv 2>&1");
+    free(output);
+    
+    char* first = read_file("shard_test.0000.json");
+    char* second = read_file("shard_test.0001.json");
+    test_assert(first && strstr(first, "\"integer\": 42") && strstr(first, "\"integer\": 100"),
+                "First shard holds leading rows");
+    test_assert(second && second[0] == '[' && strstr(second, "\"text\": \"world\"") &&
+                !strstr(second, "\"integer\": 42"), "Second shard is standalone array");
+    free(first);
+    free(second);
+    remove("shard_test.0000.json");
+    remove("shard_test.0001.json");
+    
+    output = run_cj_command("--shard-rows 40 --ndjson -o shard_test large.csv 2>&1");
+    free(output);
+    
+    char* last = read_file("shard_test.0002.ndjson");
+    int lines = 0;
+    for (char* p = last; p && *p; p++) {
+        if (*p == '\n') lines++;
+    }
+    test_assert(last && lines == 20 && strncmp(last, "{\"id\": 80,", 10) == 0,
+                "Row-sized NDJSON shards");
+    free(last);
+    remove("shard_test.0000.ndjson");
+    remove("shard_test.0001.ndjson");
+    remove("shard_test.0002.ndjson");
+}
+
+void test_dialect_options() {
+    printf(ANSI_COLOR_BLUE "\n=== Dialect Option Tests ===" ANSI_COLOR_RESET "\n");
+    
+    append_file("dialect_test.tsv", "wb", "id\tname\n 1 \t\"Doe, John\"\n2\t\tpadded\t\n");
+    char* output = run_cj_command("--delimiter tab dialect_test.tsv 2>/dev/null");
+    test_assert(output && strstr(output, "{\"id\": 1,\"name\": \"Doe, John\"}") &&
+                strstr(output, "{\"id\": 2,\"name\": \"\"}"), "Tab-delimited input keeps empty fields");
+    free(output);
+    
+    append_file("dialect_test.psv", "wb", "a|b|c\n x |'y|z'| 3\n");
+    output = run_cj_command("--delimiter '|' dialect_test.psv 2>/dev/null");
+    test_assert(output && strcmp(output, "[{\"a\": \"x\",\"b\": \"y|z\",\"c\": 3}]\n") == 0,
+                "Pipe-delimited input");
+    free(output);
+    
+    output = run_cj_command("--delimiter '|' --no-trim --quote '\"' dialect_test.psv 2>/dev/null");
+    test_assert(output && strcmp(output, "[{\"a\": \" x \",\"b\": \"'y\",\"c\": \"z'\"}]\n") == 0,
+                "No trimming and a single quote character");
+    free(output);
+    
+    append_file("dialect_test.csv", "wb", "1;\"a\"\n2;b;extra\n");
+    output = run_cj_command("--no-header --delimiter ';' --quote none dialect_test.csv 2>/dev/null");
+    test_assert(output && strcmp(output, "[{\"1\": 1,\"2\": \"\\\"a\\\"\"},{\"1\": 2,\"2\": \"b\"}]\n") == 0,
+                "Positional keys without a header record");
+    free(output);
+    
+    output = run_cj_command("--delimiter '\"' dialect_test.csv 2>&1");
+    test_assert(output && strstr(output, "Error: Invalid delimiter") != NULL, "Quote character rejected as delimiter");
+    free(output);
+    
+    remove("dialect_test.tsv");
+    remove("dialect_test.psv");
+    remove("dialect_test.csv");
+}
+
+void test_text_encoding() {
+    printf(ANSI_COLOR_BLUE "\n=== Text Encoding Tests ===" ANSI_COLOR_RESET "\n");
+
+    append_file("encoding_test.csv", "wb", "\xef\xbb\xbfname,\"say \"\"hi\"\"\"\nbell\x07,tab\there\x1f\n");
+    char* output = run_cj_command("encoding_test.csv 2>/dev/null");
+    test_assert(output && strcmp(output, "[{\"name\": \"bell\\u0007\",\"say \\\"hi\\\"\": \"tab\\there\\u001f\"}]\n") == 0,
+                "BOM stripped, controls and header keys escaped");
+    free(output);
+
+    append_file("encoding_test.csv", "wb", "city\ncaf\xe9\nZ\xc3\xbcrich\n\xed\xa0\x80!\n");
+    output = run_cj_command("encoding_test.csv 2>/dev/null");
+    test_assert(output && strcmp(output, "[{\"city\": \"caf\xef\xbf\xbd\"},{\"city\": \"Z\xc3\xbcrich\"},"
+                                         "{\"city\": \"\xef\xbf\xbd\xef\xbf\xbd\xef\xbf\xbd!\"}]\n") == 0,
+                "Ill-formed UTF-8 replaced with U+FFFD by default");
+    free(output);
+
+    output = run_cj_command("--invalid-utf8 pass encoding_test.csv 2>/dev/null");
+    test_assert(output && strstr(output, "\"caf\xe9\"") != NULL, "Pass-through policy keeps raw bytes");
+    free(output);
+
+    output = run_cj_command("--invalid-utf8 error encoding_test.csv 2>&1");
+    test_assert(output && strcmp(output, "Error: Invalid UTF-8 in row 1 at byte 4\n") == 0,
+                "Error policy rejects the input before writing");
+    free(output);
+
+    output = run_cj_command("--format msgpack encoding_test.csv > encoding_test.msgpack 2>/dev/null");
+    free(output);
+    size_t length = 0;
+    char* msgpack = read_file_length("encoding_test.msgpack", &length);
+    static const char expected[] = "\x93\x81\xa4" "city" "\xa6" "caf\xef\xbf\xbd";
+    test_assert(msgpack && length > sizeof(expected) - 1 && memcmp(msgpack, expected, sizeof(expected) - 1) == 0,
+                "Binary string lengths count the replacement characters");
+    free(msgpack);
+
+    remove("encoding_test.csv");
+    remove("encoding_test.msgpack");
+}
+
+void test_profile_mode() {
+    printf(ANSI_COLOR_BLUE "\n=== Profile Mode Tests ===" ANSI_COLOR_RESET "\n");
+
+    append_file("profile_test.csv", "wb", "id,score,city\n1,2.5,Oslo\n2,,Oslo\n3,-4,\"Bergen, NO\"\n4,x,\n");
+    char* output = run_cj_command("profile profile_test.csv 2>/dev/null");
+    test_assert(output && strstr(output, "{\"rows\": 4,\"columns\": [{\"name\": \"id\",\"count\": 4,\"empty\": 0,") == output,
+                "Profile counts rows and cells");
+    test_assert(output && strstr(output, "\"name\": \"score\",\"count\": 4,\"empty\": 1,\"empty_rate\": 0.25,"
+                                         "\"numeric\": 2,") &&
+                strstr(output, "\"integers\": 1,\"floats\": 1,\"min\": -4,\"max\": 2.5,\"max_length\": 3,"),
+                "Numeric rate and range ignore empty and non-numeric cells");
+    test_assert(output && strstr(output, "\"min\": null,\"max\": null,\"max_length\": 10,\"mean_length\": 4.5,"
+                                         "\"invalid_utf8\": 0,\"distinct\": 2}"),
+                "Text column has no range and a distinct estimate");
+    free(output);
+
+    char* single = run_cj_command("profile --threads 1 large.csv 2>/dev/null");
+    char* parallel = run_cj_command("profile --threads 4 large.csv 2>/dev/null");
+    test_assert(single && parallel && strstr(single, "\"rows\": 100,") && strcmp(single, parallel) == 0,
+                "Merged thread sketches match a single-threaded pass");
+    free(single);
+    free(parallel);
+
+    append_file("profile_test.csv", "wb", "id,name\n1,a\n2,b\n3,\xff\n4,d\n");
+    char* rejected = run_cj_command("profile --threads 2 --invalid-utf8 error profile_test.csv 2>&1");
+    test_assert(rejected && strstr(rejected, "Error: Invalid UTF-8 in row 3 at byte 3") && !strstr(rejected, "\"rows\""),
+                "Profile rejects invalid UTF-8 like conversion");
+    free(rejected);
+
+    remove("profile_test.csv");
+}
+
+void test_cache_mode() {
+    printf(ANSI_COLOR_BLUE "\n=== Cache Mode Tests ===" ANSI_COLOR_RESET "\n");
+
+#ifdef _WIN32
+    test_assert(1, "Cache mode (skipped on Windows)");
+#else
+    free(run_command("rm -rf cache_test.dir"));
+    char* expected = run_cj_command("-s large.csv 2>/dev/null");
+    char* cold = run_cj_command("-s --cache cache_test.dir large.csv 2>/dev/null");
+    char* warm = run_cj_command("-s --cache cache_test.dir large.csv 2>/dev/null");
+    test_assert(expected && cold && strcmp(expected, cold) == 0, "First cached run matches plain conversion");
+    test_assert(expected && warm && strcmp(expected, warm) == 0, "Output served from the cache is identical");
+    free(expected);
+    free(cold);
+    free(warm);
+
+    append_file("cache_test.csv", "wb", "id,name\n1,Joe\n2,Ann\n");
+    char* output = run_cj_command("--ndjson --cache cache_test.dir cache_test.csv 2>/dev/null");
+    free(output);
+    append_file("cache_test.csv", "wb", "id,name\n1,Joe\n2,Eve\n");
+    output = run_cj_command("--ndjson --cache cache_test.dir cache_test.csv 2>/dev/null");
+    test_assert(output && strcmp(output, "{\"id\": 1,\"name\": \"Joe\"}\n{\"id\": 2,\"name\": \"Eve\"}\n") == 0,
+                "Changed input is converted again");
+    free(output);
+
+    output = run_cj_command("--cache cache_test.dir --cache-size 1 cache_test.csv > /dev/null 2>&1; "
+                            "grep -c . cache_test.dir/index");
+    test_assert(output && atoi(output) == 1, "Fragments beyond the size limit are evicted");
+    free(output);
+
+    free(run_command("rm -rf cache_test.dir"));
+    remove("cache_test.csv");
+#endif
+}
+
+void test_sampling() {
+    printf(ANSI_COLOR_BLUE "\n=== Head and Sampling Tests ===" ANSI_COLOR_RESET "\n");
+
+    append_file("sample_test.csv", "wb", "id,note\n1,\"two\nlines\"\n\n2,b\n3,c\n");
+    char* output = run_cj_command("--ndjson --head 2 sample_test.csv 2>/dev/null");
+    test_assert(output && strcmp(output, "{\"id\": 1,\"note\": \"two\\nlines\"}\n{\"id\": 2,\"note\": \"b\"}\n") == 0,
+                "Head stops after N rows");
+    free(output);
+    remove("sample_test.csv");
+
+    char* expected = run_cj_command("large.csv 2>/dev/null");
+    char* all = run_cj_command("--sample 1000 large.csv 2>/dev/null");
+    char* percent = run_cj_command("--sample 100% large.csv 2>/dev/null");
+    test_assert(expected && all && percent && strcmp(expected, all) == 0 && strcmp(expected, percent) == 0,
+                "Sampling every row matches plain conversion");
+    free(expected);
+    free(all);
+    free(percent);
+
+    char* first = run_cj_command("--ndjson --sample 3 --seed 42 large.csv 2>/dev/null");
+    char* second = run_cj_command("--ndjson --sample 3 --seed 42 large.csv 2>/dev/null");
+    int rows = 0;
+    int ordered = 1;
+    long previous = -1;
+    for (const char* line = first; line && (line = strstr(line, "{\"id\": ")) != NULL; line++) {
+        long id = strtol(line + 7, NULL, 10);
+        if (id <= previous) ordered = 0;
+        previous = id;
+        rows++;
+    }
+    test_assert(first && second && strcmp(first, second) == 0 && rows == 3 && ordered,
+                "Reservoir sample has N rows in input order and repeats with a seed");
+    free(first);
+    free(second);
+
+    output = run_cj_command("--ndjson --sample 5 --sample-offsets --seed 7 large.csv 2>/dev/null");
+    rows = 0;
+    for (const char* line = output; line && (line = strstr(line, "\"field_019\": ")) != NULL; line++) rows++;
+    test_assert(output && rows == 5 && strncmp(output, "{\"id\": ", 7) == 0,
+                "Offset sampling returns whole records");
+    free(output);
+}
+
+void test_follow_mode() {
+    printf(ANSI_COLOR_BLUE "\n=== Follow Mode Tests ===" ANSI_COLOR_RESET "\n");
+    
+#ifdef _WIN32
+    test_assert(1, "Follow mode (skipped on Windows)");
+#else
+    remove("follow_test.ckpt");
+    append_file("follow_test.csv", "wb", "id,note\n1,first\n2,\"multi\nline\"\n3,par");
+    
+    // Complete record 3 while cj is waiting, and leave record 4 inside an open quote
+    char* output = run_command("../cj --follow --checkpoint follow_test.ckpt follow_test.csv "
+                               "> follow_test.out 2>&1 & pid=$!; sleep 1; "
+                               "printf 'tial\\n4,\"open' >> follow_test.csv; sleep 1; kill $pid");
+    free(output);
+    
+    char* first = read_file("follow_test.out");
+    test_assert(first && strstr(first, "{\"id\": 1,\"note\": \"first\"}\n") &&
+                strstr(first, "\"note\": \"multi\\nline\""), "Existing records converted");
+    test_assert(first && strstr(first, "\"note\": \"partial\"}\n"), "Appended record emitted once complete");
+    test_assert(first && !strstr(first, "open"), "Unterminated quoted field held back");
+    free(first);
+    
+    // Restart from the checkpoint after the quoted field is closed
+    append_file("follow_test.csv", "ab", " quote\"\n");
+    output = run_command("../cj --follow --checkpoint follow_test.ckpt follow_test.csv "
+                         "> follow_test.out 2>&1 & pid=$!; sleep 1; kill $pid");
+    free(output);
+    
+    char* second = read_file("follow_test.out");
+    test_assert(second && strcmp(second, "{\"id\": 4,\"note\": \"open quote\"}\n") == 0,
+                "Checkpoint resumes without rescanning");
+    free(second);
+    
+    // Rotate: a record still lands in the old file after the rename, then a
+    // new file with other columns takes the path and is truncated in turn
+    append_file("follow_test.csv", "wb", "id,note\n1,first\n");
+    output = run_command("../cj --follow follow_test.csv > follow_test.out 2>/dev/null & pid=$!; sleep 1; "
+                         "mv follow_test.csv follow_test.csv.1; printf '2,late\\n' >> follow_test.csv.1; "
+                         "printf 'key,value\\na,b\\n' > follow_test.csv; sleep 1; "
+                         "printf 'k\\nc\\n' > follow_test.csv; sleep 1; kill $pid");
+    free(output);
+    
+    char* third = read_file("follow_test.out");
+    test_assert(third && strstr(third, "{\"id\": 2,\"note\": \"late\"}\n") &&
+                strstr(third, "{\"key\": \"a\",\"value\": \"b\"}\n"),
+                "Rotated file drained, then reopened with its own header");
+    test_assert(third && strstr(third, "{\"k\": \"c\"}\n") && !strstr(third, "\"k\": \"k\""),
+                "Truncated file re-reads its header");
+    free(third);
+    
+    remove("follow_test.csv");
+    remove("follow_test.csv.1");
+    remove("follow_test.out");
+    remove("follow_test.ckpt");
+#endif
+}
+
+#ifndef _WIN32
+int serve_connect(const char* socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    
+    // The server may still be starting up
+    for (int attempt = 0; attempt < 50; attempt++) {
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) return fd;
+        usleep(100000);
+    }
+    close(fd);
+    return -1;
+}
+
+char* serve_read_reply(int fd) {
+    size_t capacity = 1024;
+    size_t length = 0;
+    char* response = malloc(capacity);
+    ssize_t n;
+    while (response && (n = read(fd, response + length, capacity - length - 1)) > 0) {
+        length += n;
+        if (capacity - length < 2) {
+            capacity *= 2;
+            response = realloc(response, capacity);
+        }
+    }
+    if (response) response[length] = '\0';
+    close(fd);
+    return response;
+}
+
+// Sends csv and reads the whole reply. Without finish the write side stays
+// open, like a client that stalls mid-request.
+char* serve_request(const char* socket_path, const char* csv, int finish) {
+    int fd = serve_connect(socket_path);
+    if (fd < 0) return NULL;
+    if (write(fd, csv, strlen(csv)) != (ssize_t)strlen(csv)) {
+        close(fd);
+        return NULL;
+    }
+    if (finish) shutdown(fd, SHUT_WR);
+    return serve_read_reply(fd);
+}
+
+// Sends one byte every 300 ms for 1.8 s: never idle for long, but slow
+char* serve_trickle(const char* socket_path) {
+    int fd = serve_connect(socket_path);
+    if (fd < 0) return NULL;
+    for (int i = 0; i < 6; i++) {
+        send(fd, i == 0 ? "x" : "\n", 1, MSG_NOSIGNAL);
+        usleep(300000);
+    }
+    shutdown(fd, SHUT_WR);
+    return serve_read_reply(fd);
+}
+#endif
+
+void test_serve_mode() {
+    printf(ANSI_COLOR_BLUE "\n=== Serve Mode Tests ===" ANSI_COLOR_RESET "\n");
+    
+#ifdef _WIN32
+    test_assert(1, "Serve mode (skipped on Windows)");
+#else
+    // One worker, so every request below goes through the same buffers
+    char* pid_output = run_command("../cj serve --socket cj_test.sock --threads 1 --max-request 1K --timeout 1 "
+                                   "--invalid-utf8 error > /dev/null 2>&1 & echo $!");
+    int pid = pid_output ? atoi(pid_output) : 0;
+    free(pid_output);
+    
+    char* first = serve_request("cj_test.sock", "id,name\n1,\"Doe, John\"\n2,'multi\nline'\n", 1);
+    test_assert(first && strcmp(first, "[{\"id\": 1,\"name\": \"Doe, John\"},{\"id\": 2,\"name\": \"multi\\nline\"}]\n") == 0,
+                "CSV over socket converted to JSON");
+    
+    char large[2048];
+    memset(large, 'a', sizeof(large) - 1);
+    large[sizeof(large) - 1] = '\0';
+    char* too_large = serve_request("cj_test.sock", large, 1);
+    test_assert(too_large && strcmp(too_large, "Error: Request too large\n") == 0, "Oversized request gets an error reply");
+    
+    char* invalid = serve_request("cj_test.sock", "x\n\xff\n", 1);
+    test_assert(invalid && strcmp(invalid, "Error: Cannot parse CSV\n") == 0, "Unparsable request gets an error reply");
+    
+    char* stalled = serve_request("cj_test.sock", "x\n1\n", 0);
+    test_assert(stalled && strcmp(stalled, "Error: Request timed out\n") == 0, "Stalled request times out");
+    
+    char* trickled = serve_trickle("cj_test.sock");
+    test_assert(trickled && strcmp(trickled, "Error: Request timed out\n") == 0,
+                "Trickling request hits the connection deadline");
+    
+    char* second = serve_request("cj_test.sock", "x\n42\n", 1);
+    test_assert(second && strcmp(second, "[{\"x\": 42}]\n") == 0, "Worker recovers after failed requests");
+    
+    if (pid > 0) kill(pid, SIGTERM);
+    usleep(200000);
+    test_assert(access("cj_test.sock", F_OK) != 0, "Socket removed on shutdown");
+    
+    free(first);
+    free(too_large);
+    free(invalid);
+    free(stalled);
+    free(trickled);
+    free(second);
+#endif
 }
 
 void print_summary() {
@@ -335,11 +962,23 @@ int main() {
     test_empty_fields();
     test_version_command();
     test_usage_output();
+    test_command_named_files();
     test_error_handling();
     test_special_characters();
     test_multiline_fields();
     test_complex_newlines();
     test_edge_cases();
+    test_ndjson_output();
+    test_binary_formats();
+    test_async_output();
+    test_sharded_output();
+    test_dialect_options();
+    test_text_encoding();
+    test_profile_mode();
+    test_cache_mode();
+    test_sampling();
+    test_follow_mode();
+    test_serve_mode();
     
     print_summary();
     